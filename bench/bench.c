@@ -0,0 +1,97 @@
+/**
+ * bench.c: timing, allocation counting and reports shared by benchmarks
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+/* heap calls (malloc, calloc, realloc) made so far */
+unsigned long benchNumAllocs = 0;
+
+#ifdef BENCH_WRAP_ALLOC
+/* link with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc to count calls from every object */
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t num, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+  __atomic_add_fetch(&benchNumAllocs, 1, __ATOMIC_RELAXED);
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t num, size_t size)
+{
+  __atomic_add_fetch(&benchNumAllocs, 1, __ATOMIC_RELAXED);
+  return __real_calloc(num, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+  __atomic_add_fetch(&benchNumAllocs, 1, __ATOMIC_RELAXED);
+  return __real_realloc(ptr, size);
+}
+#endif
+
+/* heap calls so far, 0 if they are not counted */
+unsigned long benchGetNumAllocs(void)
+{
+#ifdef BENCH_WRAP_ALLOC
+  return __atomic_load_n(&benchNumAllocs, __ATOMIC_RELAXED);
+#else
+  return 0;
+#endif
+}
+
+int benchCountsAllocs(void)
+{
+#ifdef BENCH_WRAP_ALLOC
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+void benchPrintHeader(void)
+{
+  printf("%-44s %12s %10s %13s\n", "benchmark", "events/s", "ns/event", "allocs/event");
+}
+
+/* start timing and counting for a line of report */
+void benchStart(BenchRun* run, const char* name)
+{
+  run->name = name;
+  run->startAllocs = benchGetNumAllocs();
+  run->startTime = clock();
+}
+
+/* print a line of report, numEvents are the events handled since benchStart */
+void benchStop(BenchRun* run, double numEvents)
+{
+  clock_t endTime = clock();
+  unsigned long numAllocs = benchGetNumAllocs() - run->startAllocs;
+  double seconds = (double) (endTime - run->startTime) / CLOCKS_PER_SEC;
+
+  if(seconds <= 0.0)
+  {
+    seconds = 1.0 / CLOCKS_PER_SEC;
+  }
+  if(numEvents < 1.0)
+  {
+    numEvents = 1.0;
+  }
+
+  if(benchCountsAllocs())
+  {
+    printf("%-44s %12.0f %10.2f %13.4f\n", run->name,
+      numEvents / seconds, seconds * 1000000000.0 / numEvents, numAllocs / numEvents);
+  }
+  else
+  {
+    printf("%-44s %12.0f %10.2f %13s\n", run->name,
+      numEvents / seconds, seconds * 1000000000.0 / numEvents, "-");
+  }
+  fflush(stdout);
+}
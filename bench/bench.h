@@ -0,0 +1,27 @@
+/**
+ * bench.h: timing, allocation counting and reports shared by benchmarks
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+
+#include <stddef.h>
+#include <time.h>
+
+/* a measurement in progress */
+typedef struct TagBenchRun
+{
+  const char* name;
+  clock_t startTime;
+  unsigned long startAllocs;
+} BenchRun;
+
+void benchPrintHeader(void);
+void benchStart(BenchRun* run, const char* name);
+void benchStop(BenchRun* run, double numEvents);
+unsigned long benchGetNumAllocs(void);
+int benchCountsAllocs(void);
+
+
+#endif /* !BENCH_H */
@@ -0,0 +1,276 @@
+/**
+ * sseqgen.c: synthetic sseq for benchmarks
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "sseqgen.h"
+
+#define SSEQ_GEN_HEADER_SIZE  0x1c
+#define SSEQ_GEN_BAR_TICKS    192   /* 4/4 at 48 ticks per quarter note */
+
+typedef struct TagSseqGenBuffer
+{
+  byte* data;
+  size_t size;
+  size_t maxSize;
+  bool failed;
+} SseqGenBuffer;
+
+/* same sequence of numbers on every platform, unlike rand */
+unsigned int sseqGenRandom(unsigned int* state)
+{
+  *state = *state * 1103515245 + 12345;
+  return (*state >> 16) & 0x7fff;
+}
+
+void sseqGenPut(SseqGenBuffer* buffer, byte value)
+{
+  if(buffer->size == buffer->maxSize)
+  {
+    size_t newMaxSize = buffer->maxSize ? (buffer->maxSize * 2) : 0x1000;
+    byte* newData = (byte*) realloc(buffer->data, newMaxSize);
+
+    if(!newData)
+    {
+      buffer->failed = true;
+      return;
+    }
+    buffer->data = newData;
+    buffer->maxSize = newMaxSize;
+  }
+  buffer->data[buffer->size++] = value;
+}
+
+void sseqGenPutU16(SseqGenBuffer* buffer, unsigned int value)
+{
+  sseqGenPut(buffer, (byte) (value & 0xff));
+  sseqGenPut(buffer, (byte) ((value >> 8) & 0xff));
+}
+
+void sseqGenPutU24(SseqGenBuffer* buffer, unsigned int value)
+{
+  sseqGenPutU16(buffer, value & 0xffff);
+  sseqGenPut(buffer, (byte) ((value >> 16) & 0xff));
+}
+
+void sseqGenPutU32(SseqGenBuffer* buffer, unsigned int value)
+{
+  sseqGenPutU16(buffer, value & 0xffff);
+  sseqGenPutU16(buffer, (value >> 16) & 0xffff);
+}
+
+void sseqGenPutVarLength(SseqGenBuffer* buffer, unsigned int value)
+{
+  byte varLength[4];
+  size_t varLengthSize = smfWriteVarLength(value, varLength, sizeof(varLength));
+  size_t byteIndex;
+
+  for(byteIndex = 0; byteIndex < varLengthSize; byteIndex++)
+  {
+    sseqGenPut(buffer, varLength[byteIndex]);
+  }
+}
+
+/* overwrite a 24-bit offset put earlier */
+void sseqGenPatchU24(SseqGenBuffer* buffer, size_t offset, unsigned int value)
+{
+  if(!buffer->failed)
+  {
+    buffer->data[offset] = (byte) (value & 0xff);
+    buffer->data[offset + 1] = (byte) ((value >> 8) & 0xff);
+    buffer->data[offset + 2] = (byte) ((value >> 16) & 0xff);
+  }
+}
+
+void sseqGenPatchU32(SseqGenBuffer* buffer, size_t offset, unsigned int value)
+{
+  sseqGenPatchU24(buffer, offset, value & 0xffffff);
+  if(!buffer->failed)
+  {
+    buffer->data[offset + 3] = (byte) ((value >> 24) & 0xff);
+  }
+}
+
+/* offset of the current position, relative to the top of DATA as commands take it */
+unsigned int sseqGenGetOffset(SseqGenBuffer* buffer)
+{
+  return (unsigned int) (buffer->size - SSEQ_GEN_HEADER_SIZE);
+}
+
+/* notes of one bar, the same ones for each track and pattern */
+void sseqGenPutBar(SseqGenBuffer* buffer, const SseqGenParams* params, int trackIndex, int patternIndex)
+{
+  unsigned int state = params->seed ^ (unsigned int) (trackIndex * 0x10001 + patternIndex * 0x100);
+  int noteTicks = SSEQ_GEN_BAR_TICKS / params->notesPerBar;
+  int noteIndex;
+
+  for(noteIndex = 0; noteIndex < params->notesPerBar; noteIndex++)
+  {
+    sseqGenPut(buffer, (byte) (0x30 + sseqGenRandom(&state) % 0x30));
+    sseqGenPut(buffer, (byte) (0x40 + sseqGenRandom(&state) % 0x40));
+    sseqGenPutVarLength(buffer, noteTicks);
+    sseqGenPut(buffer, 0x80);
+    sseqGenPutVarLength(buffer, noteTicks);
+  }
+}
+
+/* build an sseq of the given shape, free it with free() */
+byte* sseqGenCreate(const SseqGenParams* params, size_t* sseqSize)
+{
+  SseqGenBuffer buffer = { NULL, 0, 0, false };
+  unsigned int patternOffset[SSEQ_GEN_MAX_TRACK][SSEQ_GEN_NUM_PATTERNS];
+  size_t openTrackAt[SSEQ_GEN_MAX_TRACK];
+  size_t jumpToTrack0At;
+  SseqGenParams shape = *params;
+  int trackIndex;
+
+  if(shape.numTracks < 1) shape.numTracks = 1;
+  if(shape.numTracks > SSEQ_GEN_MAX_TRACK) shape.numTracks = SSEQ_GEN_MAX_TRACK;
+  if(shape.numBars < 1) shape.numBars = 1;
+  if(shape.notesPerBar < 1) shape.notesPerBar = 1;
+  if(shape.notesPerBar > SSEQ_GEN_BAR_TICKS) shape.notesPerBar = SSEQ_GEN_BAR_TICKS;
+  if(shape.loopsPerBar < 0) shape.loopsPerBar = 0;
+  if(shape.loopsPerBar > SSEQ_GEN_MAX_LOOPS) shape.loopsPerBar = SSEQ_GEN_MAX_LOOPS;
+  if(shape.callDepth < 0) shape.callDepth = 0;
+  if(shape.callDepth > SSEQ_GEN_MAX_CALL_DEPTH) shape.callDepth = SSEQ_GEN_MAX_CALL_DEPTH;
+  if(shape.silentNoteTicks < 0) shape.silentNoteTicks = 0;
+
+  /* header, sizes are put at the end */
+  sseqGenPut(&buffer, 'S');
+  sseqGenPut(&buffer, 'S');
+  sseqGenPut(&buffer, 'E');
+  sseqGenPut(&buffer, 'Q');
+  sseqGenPutU16(&buffer, 0xfeff);
+  sseqGenPutU16(&buffer, 0x0100);
+  sseqGenPutU32(&buffer, 0);
+  sseqGenPutU16(&buffer, 0x10);
+  sseqGenPutU16(&buffer, 1);
+  sseqGenPut(&buffer, 'D');
+  sseqGenPut(&buffer, 'A');
+  sseqGenPut(&buffer, 'T');
+  sseqGenPut(&buffer, 'A');
+  sseqGenPutU32(&buffer, 0);
+  sseqGenPutU32(&buffer, SSEQ_GEN_HEADER_SIZE);
+
+  /* track 0: allocate and open the others, set tempo, then skip the subroutines */
+  if(shape.numTracks > 1)
+  {
+    sseqGenPut(&buffer, 0xfe);
+    sseqGenPutU16(&buffer, (1 << shape.numTracks) - 1);
+  }
+  for(trackIndex = 1; trackIndex < shape.numTracks; trackIndex++)
+  {
+    sseqGenPut(&buffer, 0x93);
+    sseqGenPut(&buffer, (byte) trackIndex);
+    openTrackAt[trackIndex] = buffer.size;
+    sseqGenPutU24(&buffer, 0);
+  }
+  sseqGenPut(&buffer, 0xe1);
+  sseqGenPutU16(&buffer, 120);
+  sseqGenPut(&buffer, 0x94);
+  jumpToTrack0At = buffer.size;
+  sseqGenPutU24(&buffer, 0);
+
+  /* subroutines: each level calls the next one, the last one plays the bar */
+  if(shape.callDepth > 0)
+  {
+    for(trackIndex = 0; trackIndex < shape.numTracks; trackIndex++)
+    {
+      int patternIndex;
+
+      for(patternIndex = 0; patternIndex < SSEQ_GEN_NUM_PATTERNS; patternIndex++)
+      {
+        int level;
+
+        patternOffset[trackIndex][patternIndex] = sseqGenGetOffset(&buffer);
+        for(level = 1; level < shape.callDepth; level++)
+        {
+          /* next level follows right after the call and return */
+          sseqGenPut(&buffer, 0x95);
+          sseqGenPutU24(&buffer, sseqGenGetOffset(&buffer) + 3 + 1);
+          sseqGenPut(&buffer, 0xfd);
+        }
+        sseqGenPutBar(&buffer, &shape, trackIndex, patternIndex);
+        sseqGenPut(&buffer, 0xfd);
+      }
+    }
+  }
+
+  for(trackIndex = 0; trackIndex < shape.numTracks; trackIndex++)
+  {
+    unsigned int topOffset;
+    int barIndex;
+
+    if(trackIndex == 0)
+    {
+      sseqGenPatchU24(&buffer, jumpToTrack0At, sseqGenGetOffset(&buffer));
+    }
+    else
+    {
+      sseqGenPatchU24(&buffer, openTrackAt[trackIndex], sseqGenGetOffset(&buffer));
+    }
+
+    sseqGenPut(&buffer, 0x81);
+    sseqGenPutVarLength(&buffer, trackIndex);
+    sseqGenPut(&buffer, 0xc1);
+    sseqGenPut(&buffer, 100);
+    sseqGenPut(&buffer, 0xc0);
+    sseqGenPut(&buffer, 0x40);
+
+    topOffset = sseqGenGetOffset(&buffer);
+    for(barIndex = 0; barIndex < shape.numBars; barIndex++)
+    {
+      int patternIndex = barIndex % SSEQ_GEN_NUM_PATTERNS;
+      int numPlays = (shape.loopsPerBar > 0) ? shape.loopsPerBar : 1;
+      int playIndex;
+
+      /* loops in a row, the player (and the converter) keeps only one loop of a track at once */
+      for(playIndex = 0; playIndex < numPlays; playIndex++)
+      {
+        if(shape.loopsPerBar > 0)
+        {
+          sseqGenPut(&buffer, 0xd4);
+          sseqGenPut(&buffer, 2);
+        }
+        if(shape.callDepth > 0)
+        {
+          sseqGenPut(&buffer, 0x95);
+          sseqGenPutU24(&buffer, patternOffset[trackIndex][patternIndex]);
+        }
+        else
+        {
+          sseqGenPutBar(&buffer, &shape, trackIndex, patternIndex);
+        }
+        if(shape.loopsPerBar > 0)
+        {
+          sseqGenPut(&buffer, 0xfc);
+        }
+      }
+    }
+    /* a silent note is left out of midi, it must not make the song longer */
+    if((trackIndex == 0) && (shape.silentNoteTicks > 0))
+    {
+      sseqGenPut(&buffer, 0x3c);
+      sseqGenPut(&buffer, 0);
+      sseqGenPutVarLength(&buffer, shape.silentNoteTicks);
+    }
+    sseqGenPut(&buffer, 0x94);
+    sseqGenPutU24(&buffer, topOffset);
+    sseqGenPut(&buffer, 0xff);
+  }
+
+  if(buffer.failed)
+  {
+    free(buffer.data);
+    return NULL;
+  }
+
+  /* file size and DATA size */
+  sseqGenPatchU32(&buffer, 0x08, (unsigned int) buffer.size);
+  sseqGenPatchU32(&buffer, 0x14, (unsigned int) (buffer.size - 0x10));
+
+  *sseqSize = buffer.size;
+  return buffer.data;
+}
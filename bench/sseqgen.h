@@ -0,0 +1,32 @@
+/**
+ * sseqgen.h: synthetic sseq for benchmarks
+ */
+
+#ifndef SSEQGEN_H
+#define SSEQGEN_H
+
+
+#include <stddef.h>
+#include "../src/libsmfc.h"
+
+#define SSEQ_GEN_MAX_TRACK        16
+#define SSEQ_GEN_MAX_CALL_DEPTH   3   /* the player ignores deeper calls and loops */
+#define SSEQ_GEN_MAX_LOOPS        4   /* loops in a row of a bar */
+#define SSEQ_GEN_NUM_PATTERNS     4   /* bars of a track cycle through them */
+
+/* shape of a generated song */
+typedef struct TagSseqGenParams
+{
+  int numTracks;            /* 1 to 16, track 0 opens the others */
+  int numBars;              /* bars of each track, then it jumps back to its top */
+  int notesPerBar;          /* density, 1 to 192 notes in 4/4 */
+  int loopsPerBar;          /* each bar is played by LoopStart 2 ... LoopEnd this many times in a row, up to 4 */
+  int callDepth;            /* bars are played through a chain of nested calls, up to 3, 0 to put them inline */
+  unsigned int seed;
+  int silentNoteTicks;      /* track 0 ends with a note of velocity 0 this long, 0 for none */
+} SseqGenParams;
+
+byte* sseqGenCreate(const SseqGenParams* params, size_t* sseqSize);
+
+
+#endif /* !SSEQGEN_H */
@@ -0,0 +1,625 @@
+/**
+ * suite.c: microbenchmarks of libsmfc hot paths and sseq2midConvert on synthetic songs
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/sseq2mid.h"
+#include "bench.h"
+#include "sseqgen.h"
+
+#define BENCH_NUM_EVENTS  0x40000
+#define BENCH_NUM_ROUNDS  20
+#define BENCH_NUM_TRACKS  16
+
+/* a synthetic song to convert */
+typedef struct TagBenchSong
+{
+  const char* name;
+  SseqGenParams params;
+  bool logging;             /* with a log proc that drops the lines */
+} BenchSong;
+
+/* tracks, bars, notes per bar, loops per bar, call depth, seed, silent note ticks; logging */
+const BenchSong benchSong[] = {
+  { "convert: 1 track, 8 notes/bar",         {  1, 512,  8, 0, 0, 1,     0 }, false },
+  { "convert: 16 tracks, 8 notes/bar",       { 16,  64,  8, 0, 0, 1,     0 }, false },
+  { "convert: 16 tracks, logging on",        { 16,  64,  8, 0, 0, 1,     0 }, true  },
+  { "convert: 16 tracks, 48 notes/bar",      { 16,  64, 48, 0, 0, 1,     0 }, false },
+  { "convert: 4 tracks, 1 loop per bar",     {  4, 128,  8, 1, 0, 1,     0 }, false },
+  { "convert: 4 tracks, 4 loops per bar",    {  4, 128,  8, 4, 0, 1,     0 }, false },
+  { "convert: 4 tracks, calls 1 deep",       {  4, 128,  8, 0, 1, 1,     0 }, false },
+  { "convert: 4 tracks, calls 3 deep",       {  4, 128,  8, 0, 3, 1,     0 }, false },
+  { "convert: 4 tracks, loops and calls",    {  4, 128,  8, 1, 2, 1,     0 }, false },
+};
+
+/* songs only checked against sseq2midQueryInfo, not timed */
+const BenchSong benchCheckSong[] = {
+  { "silent note past the end",              {  4,  16,  8, 0, 0, 1, 20000 }, false },
+};
+
+/* timing of a converted song, as sseq2midQueryInfo should find it */
+typedef struct TagBenchMidiTiming
+{
+  int length;
+  size_t numTempos;
+  int loopStart;              /* "loopStart" marker, -1 if none */
+  int loopEnd;
+} BenchMidiTiming;
+
+/* keeps results alive, so that the compiler can't drop the work */
+size_t benchSink = 0;
+
+/* per-event varlen size, as it was before the batch kernel */
+size_t benchLegacyGetVarLengthSize(unsigned int value)
+{
+  size_t varLengthSize = 1;
+  unsigned int leftValue = value;
+
+  while((leftValue > 0x7f) && (varLengthSize < 4))
+  {
+    varLengthSize++;
+    leftValue = leftValue >> 7;
+  }
+  return varLengthSize;
+}
+
+size_t benchLegacyWriteVarLength(unsigned int value, byte* buffer)
+{
+  size_t transferedSize;
+  size_t varLengthSize = benchLegacyGetVarLengthSize(value);
+  size_t shiftCount = (varLengthSize - 1) * 7;
+
+  for(transferedSize = 0; transferedSize < (varLengthSize - 1); transferedSize++)
+  {
+    buffer[transferedSize] = (byte) ((value >> shiftCount) & 0x7f) | 0x80;
+    shiftCount -= 7;
+  }
+  buffer[transferedSize] = (byte) ((value >> shiftCount) & 0x7f);
+  return transferedSize + 1;
+}
+
+/* drop log lines, the formatting is what gets timed */
+void benchDiscardLog(const char* logMsg, void* userData)
+{
+  (void) logMsg;
+  (void) userData;
+}
+
+/* note-on at each time, with a little variety in key and channel */
+void benchMakeNote(byte* data, size_t eventIndex)
+{
+  data[0] = (byte) (0x90 | (eventIndex % 16));
+  data[1] = (byte) (0x30 + eventIndex % 0x30);
+  data[2] = 0x64;
+}
+
+/* mostly short delta-times, as in real songs, with a few long rests */
+void benchMakeTimes(int* eventTime, size_t numEvents, bool sorted)
+{
+  size_t eventIndex;
+  int curTime = 0;
+
+  srand(1);
+  for(eventIndex = 0; eventIndex < numEvents; eventIndex++)
+  {
+    int r = rand() % 100;
+
+    curTime += (r < 40) ? 0 : (r < 90) ? (rand() % 0x80) : (r < 99) ? (rand() % 0x4000) : (rand() % 0x20000);
+    eventTime[eventIndex] = curTime;
+  }
+
+  if(!sorted)
+  {
+    for(eventIndex = numEvents - 1; eventIndex > 0; eventIndex--)
+    {
+      size_t swapIndex = (size_t) rand() % (eventIndex + 1);
+      int swapTime = eventTime[eventIndex];
+
+      eventTime[eventIndex] = eventTime[swapIndex];
+      eventTime[swapIndex] = swapTime;
+    }
+  }
+}
+
+/* legato notes as sseq2mid puts them, note-off ahead of time: each one lands after the next note-on */
+void benchTrackLegato(const char* name, size_t numEvents)
+{
+  BenchRun run;
+  int round;
+
+  benchStart(&run, name);
+  for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+  {
+    SmfTrack* track = smfTrackCreate();
+    size_t noteIndex;
+
+    for(noteIndex = 0; noteIndex < numEvents / 2; noteIndex++)
+    {
+      byte data[3];
+      int noteTime = (int) noteIndex * 24;
+
+      benchMakeNote(data, noteIndex);
+      smfTrackInsertEvent(track, noteTime, 0, data, sizeof(data));
+      data[2] = 0;
+      smfTrackInsertEvent(track, noteTime + 36, 0, data, sizeof(data));
+    }
+    benchSink += smfTrackGetSize(track);
+    smfTrackDelete(track);
+  }
+  benchStop(&run, (double) numEvents * BENCH_NUM_ROUNDS);
+}
+
+/* events spread over all tracks of a new smf */
+Smf* benchMakeSmf(const int* eventTime, size_t numEvents)
+{
+  Smf* smf = smfCreate();
+  size_t eventIndex;
+
+  for(eventIndex = 0; smf && eventIndex < numEvents; eventIndex++)
+  {
+    byte data[3];
+
+    benchMakeNote(data, eventIndex);
+    smfInsertEvent(smf, eventTime[eventIndex], 0, (int) (eventIndex % BENCH_NUM_TRACKS), data, sizeof(data));
+  }
+  return smf;
+}
+
+/* run all benchmarks, or those with the filter in the name */
+bool benchSelected(const char* name, const char* filter)
+{
+  return !filter || strstr(name, filter);
+}
+
+void benchTrackInsert(const char* name, const int* eventTime, size_t numEvents)
+{
+  BenchRun run;
+  int round;
+
+  benchStart(&run, name);
+  for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+  {
+    SmfTrack* track = smfTrackCreate();
+    size_t eventIndex;
+
+    for(eventIndex = 0; eventIndex < numEvents; eventIndex++)
+    {
+      byte data[3];
+
+      benchMakeNote(data, eventIndex);
+      smfTrackInsertEvent(track, eventTime[eventIndex], 0, data, sizeof(data));
+    }
+    benchSink += smfTrackGetSize(track);
+    smfTrackDelete(track);
+  }
+  benchStop(&run, (double) numEvents * BENCH_NUM_ROUNDS);
+}
+
+void benchSmfInsert(const char* name, const int* eventTime, size_t numEvents)
+{
+  BenchRun run;
+  int round;
+
+  benchStart(&run, name);
+  for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+  {
+    Smf* smf = benchMakeSmf(eventTime, numEvents);
+
+    benchSink += smfGetSize(smf);
+    smfDelete(smf);
+  }
+  benchStop(&run, (double) numEvents * BENCH_NUM_ROUNDS);
+}
+
+/* measure from scratch each time: switching running status drops the kept size */
+void benchGetSize(const char* name, const int* eventTime, size_t numEvents)
+{
+  Smf* smf = benchMakeSmf(eventTime, numEvents);
+  BenchRun run;
+  int round;
+
+  benchStart(&run, name);
+  for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+  {
+    smfSetRunningStatus(smf, (round % 2) == 0);
+    benchSink += smfGetSize(smf);
+  }
+  benchStop(&run, (double) numEvents * BENCH_NUM_ROUNDS);
+  smfDelete(smf);
+}
+
+void benchTrackWrite(const char* name, const int* eventTime, size_t numEvents)
+{
+  SmfTrack* track = smfTrackCreate();
+  byte* buffer;
+  size_t bufferSize;
+  size_t eventIndex;
+  BenchRun run;
+  int round;
+
+  for(eventIndex = 0; eventIndex < numEvents; eventIndex++)
+  {
+    byte data[3];
+
+    benchMakeNote(data, eventIndex);
+    smfTrackInsertEvent(track, eventTime[eventIndex], 0, data, sizeof(data));
+  }
+  bufferSize = smfTrackGetSize(track);
+  buffer = (byte*) malloc(bufferSize);
+  if(buffer)
+  {
+    benchStart(&run, name);
+    for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+    {
+      benchSink += smfTrackWrite(track, buffer, bufferSize);
+    }
+    benchStop(&run, (double) numEvents * BENCH_NUM_ROUNDS);
+    free(buffer);
+  }
+  smfTrackDelete(track);
+}
+
+/* per-event encoding of delta-times against the batch kernel, all of them must give the same size */
+bool benchVarLength(const int* eventTime, size_t numEvents, const char* filter)
+{
+  byte* buffer = (byte*) malloc(numEvents * 4);
+  byte* deltaTimeSize = (byte*) malloc(numEvents);
+  size_t expectedSize;
+  BenchRun run;
+  int round;
+  bool result = true;
+
+  if(!buffer || !deltaTimeSize)
+  {
+    free(deltaTimeSize);
+    free(buffer);
+    return false;
+  }
+  expectedSize = smfGetDeltaTimeSizes(eventTime, numEvents, 0, deltaTimeSize);
+
+  if(benchSelected("varlen: size, legacy loop", filter))
+  {
+    benchStart(&run, "varlen: size, legacy loop");
+    for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+    {
+      size_t totalSize = 0;
+      int prevTime = 0;
+      size_t eventIndex;
+
+      for(eventIndex = 0; eventIndex < numEvents; eventIndex++)
+      {
+        totalSize += benchLegacyGetVarLengthSize(eventTime[eventIndex] - prevTime);
+        prevTime = eventTime[eventIndex];
+      }
+      if(totalSize != expectedSize)
+      {
+        result = false;
+      }
+    }
+    benchStop(&run, (double) numEvents * BENCH_NUM_ROUNDS);
+  }
+
+  if(benchSelected("varlen: size, smfGetVarLengthSize", filter))
+  {
+    benchStart(&run, "varlen: size, smfGetVarLengthSize");
+    for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+    {
+      size_t totalSize = 0;
+      int prevTime = 0;
+      size_t eventIndex;
+
+      for(eventIndex = 0; eventIndex < numEvents; eventIndex++)
+      {
+        totalSize += smfGetVarLengthSize(eventTime[eventIndex] - prevTime);
+        prevTime = eventTime[eventIndex];
+      }
+      if(totalSize != expectedSize)
+      {
+        result = false;
+      }
+    }
+    benchStop(&run, (double) numEvents * BENCH_NUM_ROUNDS);
+  }
+
+  if(benchSelected("varlen: size, smfGetDeltaTimeSizes", filter))
+  {
+    benchStart(&run, "varlen: size, smfGetDeltaTimeSizes");
+    for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+    {
+      if(smfGetDeltaTimeSizes(eventTime, numEvents, 0, deltaTimeSize) != expectedSize)
+      {
+        result = false;
+      }
+    }
+    benchStop(&run, (double) numEvents * BENCH_NUM_ROUNDS);
+  }
+
+  if(benchSelected("varlen: write, legacy loop", filter))
+  {
+    benchStart(&run, "varlen: write, legacy loop");
+    for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+    {
+      byte* p = buffer;
+      int prevTime = 0;
+      size_t eventIndex;
+
+      for(eventIndex = 0; eventIndex < numEvents; eventIndex++)
+      {
+        p += benchLegacyWriteVarLength(eventTime[eventIndex] - prevTime, p);
+        prevTime = eventTime[eventIndex];
+      }
+      if((size_t) (p - buffer) != expectedSize)
+      {
+        result = false;
+      }
+    }
+    benchStop(&run, (double) numEvents * BENCH_NUM_ROUNDS);
+  }
+
+  if(benchSelected("varlen: write, smfWriteVarLength", filter))
+  {
+    benchStart(&run, "varlen: write, smfWriteVarLength");
+    for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+    {
+      byte* p = buffer;
+      int prevTime = 0;
+      size_t eventIndex;
+
+      for(eventIndex = 0; eventIndex < numEvents; eventIndex++)
+      {
+        p += smfWriteVarLength(eventTime[eventIndex] - prevTime, p, 4);
+        prevTime = eventTime[eventIndex];
+      }
+      if((size_t) (p - buffer) != expectedSize)
+      {
+        result = false;
+      }
+    }
+    benchStop(&run, (double) numEvents * BENCH_NUM_ROUNDS);
+  }
+
+  if(!result)
+  {
+    fprintf(stderr, "error: varlen sizes do not match\n");
+  }
+  free(deltaTimeSize);
+  free(buffer);
+  return result;
+}
+
+/* read the end of the midi, its tempo events and the loop markers of loop style 2 */
+void benchGetMidiTiming(Smf* smf, BenchMidiTiming* timing)
+{
+  int trackIndex;
+
+  timing->length = 0;
+  timing->numTempos = 0;
+  timing->loopStart = -1;
+  timing->loopEnd = -1;
+  for(trackIndex = 0; trackIndex < smf->numTracks; trackIndex++)
+  {
+    SmfTrack* track = smf->track[trackIndex];
+    size_t eventIndex;
+
+    if(smfTrackGetEndTiming(track) > timing->length)
+    {
+      timing->length = smfTrackGetEndTiming(track);
+    }
+    for(eventIndex = 0; eventIndex < track->numEvents; eventIndex++)
+    {
+      SmfEvent* event = &track->event[eventIndex];
+      const byte* data = smfEventGetData(event);
+
+      if((event->size < 3) || (data[0] != 0xff))
+      {
+        continue;
+      }
+      if(data[1] == 0x51)
+      {
+        timing->numTempos++;
+      }
+      else if((data[1] == 0x06) && (event->size == 3 + 9) && (memcmp(&data[3], "loopStart", 9) == 0))
+      {
+        timing->loopStart = event->time;
+      }
+      else if((data[1] == 0x06) && (event->size == 3 + 7) && (memcmp(&data[3], "loopEnd", 7) == 0))
+      {
+        timing->loopEnd = event->time;
+      }
+    }
+  }
+}
+
+/* convert a song and read its timing */
+bool benchConvertTiming(const byte* sseq, size_t sseqSize, int loopStyle, BenchMidiTiming* timing)
+{
+  Sseq2mid* sseq2mid = sseq2midCreateBorrowed(sseq, sseqSize, false);
+  bool result = false;
+
+  if(sseq2mid)
+  {
+    /* loop markers are put once per song only when tracks run one by one */
+    sseq2midSetLoopCount(sseq2mid, 2);
+    sseq2midSetLoopStyle(sseq2mid, loopStyle);
+    sseq2midParallelTracks(sseq2mid, false);
+    if(sseq2midConvert(sseq2mid))
+    {
+      benchGetMidiTiming(sseq2mid->smf, timing);
+      result = true;
+    }
+    sseq2midDelete(sseq2mid);
+  }
+  return result;
+}
+
+/* sseq2midQueryInfo must give what a conversion of the song puts into midi */
+bool benchCheckQueryInfo(const BenchSong* song)
+{
+  size_t sseqSize;
+  byte* sseq = sseqGenCreate(&song->params, &sseqSize);
+  Sseq2mid* sseq2mid = NULL;
+  BenchMidiTiming timing;
+  BenchMidiTiming markers;
+  Sseq2midInfo info;
+  bool queried = false;
+  bool result = false;
+
+  if(sseq && 
+      benchConvertTiming(sseq, sseqSize, 0, &timing) && 
+      benchConvertTiming(sseq, sseqSize, 2, &markers))
+  {
+    sseq2mid = sseq2midCreateBorrowed(sseq, sseqSize, false);
+  }
+  if(sseq2mid)
+  {
+    sseq2midSetLoopCount(sseq2mid, 2);
+    queried = sseq2midQueryInfo(sseq2mid, &info);
+    if(queried)
+    {
+      result = (info.length == timing.length) && (info.numTempos == timing.numTempos) && 
+        (info.loopStart == markers.loopStart) && (info.loopEnd == markers.loopEnd);
+      if(!result)
+      {
+        fprintf(stderr, "error: sseq2midQueryInfo of %s: length %d, %d tempos, loop %d-%d; midi: length %d, %d tempos, loop %d-%d\n", 
+          song->name, info.length, (int) info.numTempos, info.loopStart, info.loopEnd, 
+          timing.length, (int) timing.numTempos, markers.loopStart, markers.loopEnd);
+      }
+    }
+    sseq2midFreeInfo(&info);
+    sseq2midDelete(sseq2mid);
+  }
+  if(!queried)
+  {
+    fprintf(stderr, "error: cannot check sseq2midQueryInfo of %s\n", song->name);
+  }
+  free(sseq);
+  return result;
+}
+
+/* events are those of the midi made, so songs of any shape compare */
+void benchConvert(const BenchSong* song)
+{
+  size_t sseqSize;
+  byte* sseq = sseqGenCreate(&song->params, &sseqSize);
+  double numEvents = 0;
+  BenchRun run;
+  int round;
+
+  if(!sseq)
+  {
+    fprintf(stderr, "error: cannot generate %s\n", song->name);
+    return;
+  }
+
+  benchStart(&run, song->name);
+  for(round = 0; round < BENCH_NUM_ROUNDS; round++)
+  {
+    Sseq2mid* sseq2mid = sseq2midCreateBorrowed(sseq, sseqSize, false);
+
+    if(sseq2mid)
+    {
+      if(song->logging)
+      {
+        sseq2midSetLogProc(sseq2mid, benchDiscardLog, NULL);
+      }
+      if(sseq2midConvert(sseq2mid))
+      {
+        int trackIndex;
+
+        for(trackIndex = 0; trackIndex < sseq2mid->smf->numTracks; trackIndex++)
+        {
+          numEvents += sseq2mid->smf->track[trackIndex]->numEvents;
+        }
+      }
+      sseq2midDelete(sseq2mid);
+    }
+  }
+  benchStop(&run, numEvents);
+  free(sseq);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* filter = (argc > 1) ? argv[1] : NULL;
+  int* sortedTime = (int*) malloc(sizeof(int) * BENCH_NUM_EVENTS);
+  int* shuffledTime = (int*) malloc(sizeof(int) * BENCH_NUM_EVENTS);
+  size_t songIndex;
+  int result = EXIT_SUCCESS;
+
+  if(!sortedTime || !shuffledTime)
+  {
+    return EXIT_FAILURE;
+  }
+  benchMakeTimes(sortedTime, BENCH_NUM_EVENTS, true);
+  benchMakeTimes(shuffledTime, BENCH_NUM_EVENTS, false);
+
+  if(!benchCountsAllocs())
+  {
+    printf("(link with -DBENCH_WRAP_ALLOC -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc to count allocations)\n");
+  }
+  benchPrintHeader();
+
+  if(benchSelected("smfTrackInsertEvent: in order", filter))
+  {
+    benchTrackInsert("smfTrackInsertEvent: in order", sortedTime, BENCH_NUM_EVENTS);
+  }
+  if(benchSelected("smfTrackInsertEvent: shuffled", filter))
+  {
+    benchTrackInsert("smfTrackInsertEvent: shuffled", shuffledTime, BENCH_NUM_EVENTS);
+  }
+  if(benchSelected("smfTrackInsertEvent: overlapping notes", filter))
+  {
+    benchTrackLegato("smfTrackInsertEvent: overlapping notes", BENCH_NUM_EVENTS);
+  }
+  if(benchSelected("smfInsertEvent: 16 tracks", filter))
+  {
+    benchSmfInsert("smfInsertEvent: 16 tracks", sortedTime, BENCH_NUM_EVENTS);
+  }
+  if(benchSelected("smfGetSize: 16 tracks", filter))
+  {
+    benchGetSize("smfGetSize: 16 tracks", sortedTime, BENCH_NUM_EVENTS);
+  }
+  if(benchSelected("smfTrackWrite", filter))
+  {
+    benchTrackWrite("smfTrackWrite", sortedTime, BENCH_NUM_EVENTS);
+  }
+  if(!benchVarLength(sortedTime, BENCH_NUM_EVENTS, filter))
+  {
+    result = EXIT_FAILURE;
+  }
+
+  for(songIndex = 0; songIndex < sizeof(benchSong) / sizeof(benchSong[0]); songIndex++)
+  {
+    if(benchSelected(benchSong[songIndex].name, filter))
+    {
+      benchConvert(&benchSong[songIndex]);
+    }
+  }
+
+  /* not timed, a wrong result fails the run */
+  if(benchSelected("check: sseq2midQueryInfo", filter))
+  {
+    for(songIndex = 0; songIndex < sizeof(benchSong) / sizeof(benchSong[0]); songIndex++)
+    {
+      if(!benchCheckQueryInfo(&benchSong[songIndex]))
+      {
+        result = EXIT_FAILURE;
+      }
+    }
+    for(songIndex = 0; songIndex < sizeof(benchCheckSong) / sizeof(benchCheckSong[0]); songIndex++)
+    {
+      if(!benchCheckQueryInfo(&benchCheckSong[songIndex]))
+      {
+        result = EXIT_FAILURE;
+      }
+    }
+    printf("%-44s %s\n", "check: sseq2midQueryInfo", (result == EXIT_SUCCESS) ? "ok" : "failed");
+  }
+
+  free(shuffledTime);
+  free(sortedTime);
+  return result;
+}
@@ -9,6 +9,11 @@
 #include <memory.h>
 #include "libsmfc.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SMF_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 #define SMF_VARLEN_MAX          4
 #define SMF_TIMEBASE_MAX        0x7fff
 #define SMF_CHANNEL_MAX         0x0f
@@ -31,16 +36,33 @@
 
 #define SMF_MTHD_SIZE           14
 #define SMF_MTRK_SIZE           8
+#define SMF_STREAM_BUFFER_SIZE  0x1000
+
+#define SMF_DELTA_BATCH_SIZE    256
+#define SMF_ORDER_MAX_SHIFT     1024  /* out of order events placed further back make the size stale */
+
+#define SMF_PORT_PREFIX_SIZE    4
+#define SMF_PORT_NONE           255 // nonsense number to make sure most tracks have port:0
+
+#define SMF_ARENA_ALIGN         sizeof(void*)
+#define SMF_ARENA_HEADER_SIZE   ((sizeof(SmfArenaBlock) + SMF_ARENA_ALIGN - 1) & ~(SMF_ARENA_ALIGN - 1))
+#define SMF_ARENA_MIN_BLOCK     0x1000
+#define SMF_ARENA_MAX_BLOCK     0x40000
 
-unsigned int smfReadVarLength(byte* buffer, size_t bufferSize)
+unsigned int smfReadVarLength(const byte* buffer, size_t bufferSize)
 {
   unsigned int value;
   size_t transferedSize = 0;
   size_t maxSizeToTransfer = (SMF_VARLEN_MAX < bufferSize) 
     ? SMF_VARLEN_MAX : bufferSize;
 
+  if(maxSizeToTransfer == 0)
+  {
+    return 0;
+  }
+
   value = buffer[transferedSize] & 0x7f;
-  while((transferedSize < maxSizeToTransfer) && (buffer[transferedSize] & 0x80))
+  while((transferedSize + 1 < maxSizeToTransfer) && (buffer[transferedSize] & 0x80))
   {
     transferedSize++;
     value = value << 7;
@@ -72,86 +94,237 @@ size_t smfWriteByte(size_t sizeToTransfer, unsigned int value, byte* buffer, siz
 
 size_t smfGetVarLengthSize(unsigned int value)
 {
-  size_t varLengthSize = 1;
-  unsigned int leftValue = value;
+  return 1 + (value > 0x7f) + (value > 0x3fff) + (value > 0x1fffff);
+}
+
+size_t smfWriteVarLength(unsigned int value, byte* buffer, size_t bufferSize)
+{
+  size_t transferedSize = 0;
 
-  while((leftValue > 0x7f) && (varLengthSize < SMF_VARLEN_MAX))
+  if(buffer && bufferSize)
   {
-    varLengthSize++;
-    leftValue = leftValue >> 7;
+    if(value <= 0x7f)
+    {
+      /* the most common case by far */
+      buffer[transferedSize++] = (byte) value;
+    }
+    else
+    {
+      size_t varLengthSize = smfGetVarLengthSize(value);
+      size_t sizeToTransfer = (varLengthSize < bufferSize) 
+        ? varLengthSize : bufferSize;
+      size_t shiftCount = (varLengthSize - 1) * 7;
+
+      for(transferedSize = 0; transferedSize < (sizeToTransfer - 1); transferedSize++)
+      {
+        buffer[transferedSize] = (byte) ((value >> shiftCount) & 0x7f) | 0x80;
+        shiftCount -= 7;
+      }
+      buffer[transferedSize] = (byte) ((value >> shiftCount) & 0x7f);
+      transferedSize++;
+    }
   }
-  return varLengthSize;
+  return transferedSize;
 }
 
-size_t smfWriteVarLength(unsigned int value, byte* buffer, size_t bufferSize)
+/* measure the delta-times of a sorted time array at once, returns the total size
+   (the size of each delta-time is stored to deltaTimeSize, unless it is NULL) */
+size_t smfGetDeltaTimeSizes(const int* time, size_t numTimes, int prevTime, byte* deltaTimeSize)
 {
-  size_t transferedSize = 0;
-  size_t varLengthSize = smfGetVarLengthSize(value);
-  size_t sizeToTransfer = (varLengthSize < bufferSize) 
-    ? varLengthSize : bufferSize;
+  size_t totalSize = 0;
+  size_t timeIndex = 0;
+
+#ifdef SMF_USE_SSE2
+  if(numTimes >= 4)
+  {
+    /* unsigned compare by flipping the sign bits of both sides */
+    const __m128i signBit = _mm_set1_epi32((int) 0x80000000);
+    const __m128i limit1 = _mm_set1_epi32((int) (0x7f ^ 0x80000000));
+    const __m128i limit2 = _mm_set1_epi32((int) (0x3fff ^ 0x80000000));
+    const __m128i limit3 = _mm_set1_epi32((int) (0x1fffff ^ 0x80000000));
+    const __m128i one = _mm_set1_epi32(1);
+    __m128i prevTimes = _mm_slli_si128(_mm_cvtsi32_si128(prevTime), 12);
+    __m128i sizeSum = _mm_setzero_si128();
+    int laneSum[4];
+
+    for(; (timeIndex + 4) <= numTimes; timeIndex += 4)
+    {
+      __m128i times = _mm_loadu_si128((const __m128i*) &time[timeIndex]);
+      __m128i lastTimes = _mm_or_si128(_mm_slli_si128(times, 4), _mm_srli_si128(prevTimes, 12));
+      __m128i deltas = _mm_xor_si128(_mm_sub_epi32(times, lastTimes), signBit);
+      __m128i sizes = one;
+
+      sizes = _mm_sub_epi32(sizes, _mm_cmpgt_epi32(deltas, limit1));
+      sizes = _mm_sub_epi32(sizes, _mm_cmpgt_epi32(deltas, limit2));
+      sizes = _mm_sub_epi32(sizes, _mm_cmpgt_epi32(deltas, limit3));
+      sizeSum = _mm_add_epi32(sizeSum, sizes);
+      if(deltaTimeSize)
+      {
+        __m128i packedSizes = _mm_packs_epi32(sizes, sizes);
+        int packedValue = _mm_cvtsi128_si32(_mm_packus_epi16(packedSizes, packedSizes));
+
+        memcpy(&deltaTimeSize[timeIndex], &packedValue, 4);
+      }
+      prevTimes = times;
+    }
+
+    _mm_storeu_si128((__m128i*) laneSum, sizeSum);
+    totalSize = (size_t) laneSum[0] + laneSum[1] + laneSum[2] + laneSum[3];
+    prevTime = time[timeIndex - 1];
+  }
+#endif
 
-  if(buffer && sizeToTransfer)
+  for(; timeIndex < numTimes; timeIndex++)
   {
-    size_t shiftCount = (varLengthSize - 1) * 7;
+    size_t varLengthSize = smfGetVarLengthSize((unsigned int) (time[timeIndex] - prevTime));
 
-    for(transferedSize = 0; transferedSize < (sizeToTransfer - 1); transferedSize++)
+    if(deltaTimeSize)
     {
-      buffer[transferedSize] = (byte) ((value >> shiftCount) & 0x7f) | 0x80;
-      shiftCount -= 7;
+      deltaTimeSize[timeIndex] = (byte) varLengthSize;
     }
-    buffer[transferedSize] = (byte) ((value >> shiftCount) & 0x7f);
-    transferedSize++;
+    totalSize += varLengthSize;
+    prevTime = time[timeIndex];
   }
-  return transferedSize;
+  return totalSize;
 }
 
 
-bool smfEventIsNoteOff(SmfEvent* event);
+SmfArena* smfArenaCreate(void)
+{
+  return (SmfArena*) calloc(1, sizeof(SmfArena));
+}
 
-SmfEvent* smfEventCreate(int time, int port, const byte* data, size_t dataSize)
+void smfArenaDelete(SmfArena* arena)
 {
-  SmfEvent* newEvent = NULL;
+  if(arena)
+  {
+    SmfArenaBlock* block = arena->firstBlock;
 
-  if(data && dataSize && (time >= 0) && (port >= 0) 
-      && (port < SMF_PORT_MAX))
+    while(block)
+    {
+      SmfArenaBlock* nextBlock = block->nextBlock;
+      free(block);
+      block = nextBlock;
+    }
+    free(arena);
+  }
+}
+
+void* smfArenaAlloc(SmfArena* arena, size_t size)
+{
+  void* newMemory = NULL;
+
+  if(arena && size)
   {
-    newEvent = (SmfEvent*) calloc(1, sizeof(SmfEvent));
-    if(newEvent)
+    SmfArenaBlock* block = arena->firstBlock;
+    size_t alignedSize = (size + SMF_ARENA_ALIGN - 1) & ~(SMF_ARENA_ALIGN - 1);
+
+    if(!block || (block->blockSize - block->usedSize < alignedSize))
     {
-      newEvent->data = (byte*) malloc(dataSize);
-      if(newEvent->data)
+      /* grow geometrically, so that a whole song fits in a handful of blocks */
+      size_t newBlockSize = block ? (block->blockSize * 2) : SMF_ARENA_MIN_BLOCK;
+
+      if(newBlockSize > SMF_ARENA_MAX_BLOCK)
       {
-        memcpy(newEvent->data, data, dataSize);
-        newEvent->size = dataSize;
-        newEvent->time = time;
-        newEvent->port = port;
+        newBlockSize = SMF_ARENA_MAX_BLOCK;
       }
-      else
+      if(newBlockSize < SMF_ARENA_HEADER_SIZE + alignedSize)
+      {
+        newBlockSize = SMF_ARENA_HEADER_SIZE + alignedSize;
+      }
+
+      block = (SmfArenaBlock*) malloc(newBlockSize);
+      if(block)
       {
-        free(newEvent);
-        newEvent = NULL;
+        block->nextBlock = arena->firstBlock;
+        block->blockSize = newBlockSize;
+        block->usedSize = SMF_ARENA_HEADER_SIZE;
+        arena->firstBlock = block;
       }
     }
+
+    if(block)
+    {
+      newMemory = (byte*) block + block->usedSize;
+      block->usedSize += alignedSize;
+    }
+  }
+  return newMemory;
+}
+
+
+bool smfEventIsNoteOff(SmfEvent* event);
+bool smfEventInit(SmfEvent* event, SmfArena* arena, int time, int port, const byte* data, size_t dataSize);
+
+SmfEvent* smfEventCreate(int time, int port, const byte* data, size_t dataSize)
+{
+  SmfEvent* newEvent = (SmfEvent*) malloc(sizeof(SmfEvent));
+
+  if(newEvent)
+  {
+    if(!smfEventInit(newEvent, NULL, time, port, data, dataSize))
+    {
+      free(newEvent);
+      newEvent = NULL;
+    }
   }
   return newEvent;
 }
 
+/* fill an event record, long payloads go to the arena (or to the heap, if arena is NULL) */
+bool smfEventInit(SmfEvent* event, SmfArena* arena, int time, int port, const byte* data, size_t dataSize)
+{
+  bool result = false;
+
+  if(data && dataSize && (dataSize <= SMF_EVENT_SIZE_MAX) && (time >= 0) 
+      && (port >= 0) && (port < SMF_PORT_MAX))
+  {
+    byte* eventData = event->payload.inlineData;
+
+    if(dataSize > SMF_EVENT_INLINE_SIZE)
+    {
+      eventData = arena ? (byte*) smfArenaAlloc(arena, dataSize) : (byte*) malloc(dataSize);
+      event->payload.data = eventData;
+    }
+
+    if(eventData)
+    {
+      memcpy(eventData, data, dataSize);
+      event->time = time;
+      event->size = (unsigned int) dataSize;
+      event->port = (unsigned int) port;
+      result = true;
+    }
+  }
+  return result;
+}
+
+/* delete an event created by smfEventCreate */
 void smfEventDelete(SmfEvent* event)
 {
   if(event)
   {
-    free(event->data);
+    if(event->size > SMF_EVENT_INLINE_SIZE)
+    {
+      free(event->payload.data);
+    }
     free(event);
   }
 }
 
+byte* smfEventGetData(SmfEvent* event)
+{
+  return (event->size <= SMF_EVENT_INLINE_SIZE) 
+    ? event->payload.inlineData : event->payload.data;
+}
+
 SmfEvent* smfEventCopy(SmfEvent* event)
 {
   SmfEvent* newEvent = NULL;
 
   if(event)
   {
-    newEvent = smfEventCreate(event->time, event->port, event->data, event->size);
+    newEvent = smfEventCreate(event->time, event->port, smfEventGetData(event), event->size);
   }
   return newEvent;
 }
@@ -170,7 +343,7 @@ size_t smfEventWrite(SmfEvent* event, byte* buffer, size_t bufferSize)
     size_t sizeToTransfer = (event->size < bufferSize) 
       ? event->size : bufferSize;
 
-    memcpy(buffer, event->data, sizeToTransfer);
+    memcpy(buffer, smfEventGetData(event), sizeToTransfer);
     transferedSize += sizeToTransfer;
   }
 
@@ -212,7 +385,8 @@ bool smfEventIsNoteOff(SmfEvent* event)
 
   if(event)
   {
-    byte eventMessage = (event->data[0] & SMF_EVENT_MASK_MESSAGE);
+    byte* eventData = smfEventGetData(event);
+    byte eventMessage = (eventData[0] & SMF_EVENT_MASK_MESSAGE);
 
     switch(eventMessage)
     {
@@ -223,7 +397,7 @@ bool smfEventIsNoteOff(SmfEvent* event)
     case SMF_EVENT_NOTEON:
       if(3 <= event->size)
       {
-        int velocity = event->data[2];
+        int velocity = eventData[2];
 
         eventIsNoteOff = (velocity == 0);
       }
@@ -237,26 +411,64 @@ bool smfEventIsNoteOff(SmfEvent* event)
 }
 
 
-typedef bool (SmfTrackEnumEventsProc)(SmfEvent*, void*);
+bool smfTrackSortEvents(SmfTrack* track);
+
+typedef bool (SmfTrackEnumEventsProc)(SmfEvent*, const byte*, size_t, void*);
 bool smfTrackEnumEvents(SmfTrack* track, SmfTrackEnumEventsProc* eventProc, void* customData);
 
-typedef struct TagSmfTrackGetSizeProcInfo
-{
-  int prevEventTime;
-  size_t trackSize;
-} SmfTrackGetSizeProcInfo;
+bool smfEventChangesPort(SmfEvent* event, int* prevEventPort);
+size_t smfEventGetRunningStatusSkip(SmfEvent* event, byte* runningStatus);
+
+void smfTrackResetSizeInfo(SmfTrack* track);
+void smfTrackDropSizeInfo(SmfTrack* track);
+void smfTrackMeasureEvents(SmfTrack* track);
 bool smfTrackGetSizeProc(SmfEvent* event, void* customData);
+bool smfTrackReserveEvents(SmfTrack* track, size_t newMaxEvents);
+bool smfTrackStartOrder(SmfTrack* track);
+bool smfTrackInsertOrder(SmfTrack* track, size_t newIndex);
+void smfTrackGetSizeInfoAt(SmfTrack* track, size_t position, SmfTrackGetSizeProcInfo* info);
 
 typedef struct TagSmfTrackWriteProcInfo
 {
   int prevEventTime;
+  int prevEventPort;
+  bool useRunningStatus;
+  byte runningStatus;
   byte* buffer;
   size_t bufferSize;
   size_t transferedSize;
 } SmfTrackWriteProcInfo;
-bool smfTrackWriteProc(SmfEvent* event, void* customData);
+bool smfTrackWriteProc(SmfEvent* event, const byte* deltaTimeSize, size_t numEvents, void* customData);
+bool smfTrackWriteEvent(SmfTrackWriteProcInfo* info, SmfEvent* event, size_t deltaTimeSize);
+bool smfTrackWriteMessage(SmfTrackWriteProcInfo* info, int time, size_t deltaTimeSize, const byte* data, size_t dataSize);
+
+typedef struct TagSmfTrackWriteSinkProcInfo
+{
+  int prevEventTime;
+  int prevEventPort;
+  bool useRunningStatus;
+  byte runningStatus;
+  SmfWriteProc* writeProc;
+  void* userData;
+  size_t transferedSize;
+  size_t bufferedSize;
+  byte buffer[SMF_STREAM_BUFFER_SIZE];
+} SmfTrackWriteSinkProcInfo;
+bool smfTrackWriteSinkProc(SmfEvent* event, const byte* deltaTimeSize, size_t numEvents, void* customData);
+bool smfTrackWriteSinkEvent(SmfTrackWriteSinkProcInfo* info, SmfEvent* event, size_t deltaTimeSize);
+bool smfTrackWriteSinkMessage(SmfTrackWriteSinkProcInfo* info, int time, size_t deltaTimeSize, const byte* data, size_t dataSize);
+bool smfTrackWriteSinkData(SmfTrackWriteSinkProcInfo* info, const byte* data, size_t dataSize);
+bool smfTrackWriteSinkFlush(SmfTrackWriteSinkProcInfo* info);
+size_t smfTrackWriteSinkEvents(SmfTrack* track, const byte* MTrkData, SmfWriteProc* writeProc, void* userData);
+bool smfFileWriteProc(const byte* data, size_t dataSize, void* userData);
 
 SmfTrack* smfTrackCreate(void)
+{
+  return smfTrackCreateInArena(NULL);
+}
+
+/* create a track whose events live in the given arena (or a private one, if arena is NULL) */
+SmfTrack* smfTrackCreateInArena(SmfArena* arena)
 {
   SmfTrack* newTrack;
 
@@ -264,13 +476,15 @@ SmfTrack* smfTrackCreate(void)
   if(newTrack)
   {
     const byte endOfTrackData[] = { 0xff, 0x2f, 0x00 };
-    SmfEvent* endOfTrack;
 
-    endOfTrack = smfEventCreate(0, 0, endOfTrackData, sizeof(endOfTrackData));
-    if(endOfTrack)
+    newTrack->arena = arena ? arena : smfArenaCreate();
+    newTrack->ownsArena = (arena == NULL);
+    if(newTrack->arena)
     {
-      newTrack->firstEvent = endOfTrack;
-      newTrack->lastEvent = endOfTrack;
+      smfEventInit(&newTrack->endOfTrack, NULL, 0, 0, endOfTrackData, sizeof(endOfTrackData));
+      newTrack->sorted = true;
+      smfTrackResetSizeInfo(newTrack);
+      newTrack->sizeInfoValid = true;
     }
     else
     {
@@ -285,17 +499,19 @@ void smfTrackDelete(SmfTrack* track)
 {
   if(track)
   {
-    SmfEvent* event = track->firstEvent;
-
-    while(event)
+    /* long payloads are released all together with the arena */
+    free(track->event);
+    free(track->order);
+    if(track->ownsArena)
     {
-      SmfEvent* nextEvent = event->nextEvent;
-      smfEventDelete(event);
-      event = nextEvent;
+      smfArenaDelete(track->arena);
     }
+    free(track);
   }
 }
 
+bool smfTrackCopyEvents(SmfTrack* newTrack, SmfTrack* track);
+
 SmfTrack* smfTrackCopy(SmfTrack* track)
 {
   SmfTrack* newTrack = NULL;
@@ -305,237 +521,932 @@ SmfTrack* smfTrackCopy(SmfTrack* track)
     newTrack = smfTrackCreate();
     if(newTrack)
     {
-      SmfEvent* event = track->firstEvent;
-
-      while(event != track->lastEvent)
+      if(!smfTrackCopyEvents(newTrack, track))
       {
-        smfTrackInsertEvent(newTrack, event->time, event->port, event->data, event->size);
-        event = event->nextEvent;
+        smfTrackDelete(newTrack);
+        newTrack = NULL;
       }
-      smfTrackSetEndTiming(newTrack, smfTrackGetEndTiming(track));
     }
   }
   return newTrack;
 }
 
-bool smfTrackInsertEvent(SmfTrack* track, int time, int port, const byte* data, size_t dataSize)
+/* clone all events of track into (empty) newTrack, records and long payloads are copied in bulk */
+bool smfTrackCopyEvents(SmfTrack* newTrack, SmfTrack* track)
 {
-  SmfEvent* newEvent = smfEventCreate(time, port, data, dataSize);
+  bool result = false;
+  SmfEvent* newEventList = NULL;
+  byte* payloadBuffer = NULL;
+  size_t payloadSize = 0;
+  size_t eventIndex;
 
-  if(newEvent)
+  for(eventIndex = 0; eventIndex < track->numEvents; eventIndex++)
   {
-    SmfEvent* nextEvent;
-    SmfEvent* prevEvent;
-
-    if(newEvent->time > smfTrackGetEndTiming(track))
+    if(track->event[eventIndex].size > SMF_EVENT_INLINE_SIZE)
     {
-      smfTrackSetEndTiming(track, newEvent->time);
+      payloadSize += track->event[eventIndex].size;
     }
+  }
 
-    prevEvent = track->lastEvent->prevEvent;
-    while(prevEvent && (smfEventCompare(newEvent, prevEvent) < 0))
-    {
-      prevEvent = prevEvent->prevEvent;
-    }
-    nextEvent = prevEvent ? prevEvent->nextEvent : track->firstEvent;
+  if(track->numEvents > 0)
+  {
+    newEventList = (SmfEvent*) malloc(sizeof(SmfEvent) * track->numEvents);
+  }
+  if(payloadSize > 0)
+  {
+    payloadBuffer = (byte*) smfArenaAlloc(newTrack->arena, payloadSize);
+  }
 
-    newEvent->prevEvent = prevEvent;
-    newEvent->nextEvent = nextEvent;
-    if(nextEvent)
-    {
-      nextEvent->prevEvent = newEvent;
-    }
-    else
+  if((newEventList || track->numEvents == 0) && (payloadBuffer || payloadSize == 0))
+  {
+    if(track->numEvents > 0)
     {
-      track->lastEvent = newEvent;
+      memcpy(newEventList, track->event, sizeof(SmfEvent) * track->numEvents);
     }
-    if(prevEvent)
+    for(eventIndex = 0; eventIndex < track->numEvents; eventIndex++)
     {
-      prevEvent->nextEvent = newEvent;
+      SmfEvent* newEvent = &newEventList[eventIndex];
+
+      if(newEvent->size > SMF_EVENT_INLINE_SIZE)
+      {
+        memcpy(payloadBuffer, newEvent->payload.data, newEvent->size);
+        newEvent->payload.data = payloadBuffer;
+        payloadBuffer += newEvent->size;
+      }
     }
-    else
+
+    free(newTrack->event);
+    newTrack->event = newEventList;
+    newTrack->numEvents = track->numEvents;
+    newTrack->maxEvents = track->numEvents;
+    newTrack->sorted = track->sorted;
+    newTrack->lastEventTiming = track->lastEventTiming;
+    newTrack->endOfTrack = track->endOfTrack;
+    newTrack->runningStatus = track->runningStatus;
+    newTrack->sizeInfo = track->sizeInfo;
+    newTrack->sizeInfoValid = track->sizeInfoValid;
+    free(newTrack->order);
+    newTrack->order = NULL;
+    if(track->order)
     {
-      track->firstEvent = newEvent;
+      newTrack->order = (size_t*) malloc(sizeof(size_t) * (track->numEvents ? track->numEvents : 1));
+      if(newTrack->order)
+      {
+        memcpy(newTrack->order, track->order, sizeof(size_t) * track->numEvents);
+      }
+      else
+      {
+        newTrack->sizeInfoValid = false;
+      }
     }
+    result = true;
+  }
+  else
+  {
+    free(newEventList);
   }
-  return (bool) (newEvent != NULL);
+  return result;
 }
 
-size_t smfTrackGetSize(SmfTrack* track)
+/* grow the event list (and the output order, if any) */
+bool smfTrackReserveEvents(SmfTrack* track, size_t newMaxEvents)
 {
-  size_t trackSize = 0;
+  SmfEvent* newEventList;
 
-  if(track)
+  if(newMaxEvents <= track->maxEvents)
   {
-    SmfTrackGetSizeProcInfo info;
-
-    info.prevEventTime = 0;
-    info.trackSize = SMF_MTRK_SIZE;
-    smfTrackEnumEvents(track, smfTrackGetSizeProc, &info);
-    trackSize = info.trackSize;
+    return true;
   }
-  return trackSize;
-}
+  newEventList = (SmfEvent*) realloc(track->event, sizeof(SmfEvent) * newMaxEvents);
+  if(!newEventList)
+  {
+    return false;
+  }
+  track->event = newEventList;
+  track->maxEvents = newMaxEvents;
 
-bool smfTrackGetSizeProc(SmfEvent* event, void* customData)
-{
-  SmfTrackGetSizeProcInfo* info = (SmfTrackGetSizeProcInfo*) customData;
-  int deltaTime = event->time - info->prevEventTime;
-  size_t deltaTimeSize = smfGetVarLengthSize(deltaTime);
+  if(track->order)
+  {
+    size_t* newOrder = (size_t*) realloc(track->order, sizeof(size_t) * newMaxEvents);
 
-  info->trackSize += deltaTimeSize;
-  info->trackSize += event->size;
-  info->prevEventTime = event->time;
+    if(newOrder)
+    {
+      track->order = newOrder;
+    }
+    else
+    {
+      smfTrackDropSizeInfo(track);
+    }
+  }
   return true;
 }
 
-size_t smfTrackWrite(SmfTrack* track, byte* buffer, size_t bufferSize)
+bool smfTrackInsertEvent(SmfTrack* track, int time, int port, const byte* data, size_t dataSize)
 {
-  size_t transferedSize = 0;
+  bool result = false;
 
-  if(track && buffer && bufferSize)
+  if((track->numEvents == track->maxEvents) 
+      && !smfTrackReserveEvents(track, track->maxEvents ? (track->maxEvents * 2) : 64))
   {
-    byte MTrkData[SMF_MTRK_SIZE] = { 'M', 'T', 'r', 'k', 0, 0, 0, 0 };
-    size_t trackSize = smfTrackGetSize(track);
+    return false;
+  }
 
-    smfWriteByte(4, (unsigned int) (trackSize - SMF_MTRK_SIZE), &MTrkData[4], 4);
-    if(bufferSize >= SMF_MTRK_SIZE)
+  /* events are appended as they come, and sorted once before output */
+  if(smfEventInit(&track->event[track->numEvents], track->arena, time, port, data, dataSize))
+  {
+    SmfEvent* newEvent = &track->event[track->numEvents];
+
+    if(track->sorted && (track->numEvents > 0) 
+        && (smfEventCompare(newEvent, newEvent - 1) < 0))
     {
-      SmfTrackWriteProcInfo info;
+      track->sorted = false;
+      if(track->sizeInfoValid && !smfTrackStartOrder(track))
+      {
+        smfTrackDropSizeInfo(track);
+      }
+    }
+    track->numEvents++;
 
-      memcpy(&buffer[transferedSize], MTrkData, SMF_MTRK_SIZE);
-      transferedSize += SMF_MTRK_SIZE;
+    /* an in-order append only adds its own encoded size, others are measured where they go */
+    if(track->sizeInfoValid)
+    {
+      if(track->order)
+      {
+        if(!smfTrackInsertOrder(track, track->numEvents - 1))
+        {
+          smfTrackDropSizeInfo(track);
+        }
+      }
+      else
+      {
+        smfTrackGetSizeProc(newEvent, &track->sizeInfo);
+      }
+    }
 
-      info.prevEventTime = 0;
-      info.buffer = buffer;
-      info.bufferSize = bufferSize;
-      info.transferedSize = transferedSize;
-      smfTrackEnumEvents(track, smfTrackWriteProc, &info);
-      transferedSize = info.transferedSize;
+    if(time > track->lastEventTiming)
+    {
+      track->lastEventTiming = time;
     }
-    else
+    if(time > smfTrackGetEndTiming(track))
     {
-      memcpy(&buffer[transferedSize], MTrkData, bufferSize - transferedSize);
-      transferedSize = bufferSize;
+      smfTrackSetEndTiming(track, time);
     }
+    result = true;
   }
-  return transferedSize;
+  return result;
 }
 
-bool smfTrackWriteProc(SmfEvent* event, void* customData)
+/* append copies of events already in the track, shifted in time */
+bool smfTrackRepeatEvents(SmfTrack* track, size_t firstEvent, size_t numEvents, int timeShift)
 {
-  bool result = false;
-  SmfTrackWriteProcInfo* info = (SmfTrackWriteProcInfo*) customData;
-  byte* buffer = info->buffer;
-  size_t bufferSize = info->bufferSize;
-  size_t transferedSize = info->transferedSize;
-  int deltaTime = event->time - info->prevEventTime;
-  size_t deltaTimeSize = smfGetVarLengthSize(deltaTime);
+  size_t eventIndex;
 
-  if(bufferSize >= (transferedSize + deltaTimeSize))
+  if((firstEvent > track->numEvents) || (numEvents > track->numEvents - firstEvent))
   {
-    smfWriteVarLength(deltaTime, &buffer[transferedSize], deltaTimeSize);
-    transferedSize += deltaTimeSize;
+    return false;
+  }
+
+  /* make room first, so that the source events stay in place */
+  if(track->numEvents + numEvents > track->maxEvents)
+  {
+    size_t newMaxEvents = track->maxEvents ? track->maxEvents : 64;
 
-    if(bufferSize >= (transferedSize + event->size))
+    while(newMaxEvents < track->numEvents + numEvents)
     {
-      memcpy(&buffer[transferedSize], event->data, event->size);
-      transferedSize += event->size;
-      result = true;
+      newMaxEvents *= 2;
     }
-    else
+    if(!smfTrackReserveEvents(track, newMaxEvents))
     {
-      memcpy(&buffer[transferedSize], event->data, bufferSize - transferedSize);
-      transferedSize = bufferSize;
+      return false;
     }
   }
-  else
+
+  for(eventIndex = firstEvent; eventIndex < firstEvent + numEvents; eventIndex++)
   {
-    smfWriteVarLength(deltaTime, &buffer[transferedSize], bufferSize - transferedSize);
-    transferedSize = bufferSize;
-  }
+    SmfEvent event = track->event[eventIndex];
 
-  info->prevEventTime = event->time;
-  info->transferedSize = transferedSize;
-  return result;
+    if(!smfTrackInsertEvent(track, event.time + timeShift, event.port, smfEventGetData(&event), event.size))
+    {
+      return false;
+    }
+  }
+  return true;
 }
 
-bool smfTrackEnumEvents(SmfTrack* track, SmfTrackEnumEventsProc* eventProc, void* customData)
+/* stable merge sort of track events, in the order of smfEventCompare */
+void smfTrackMergeSortEvents(SmfEvent* event, SmfEvent* work, size_t numEvents)
 {
-  bool result = false;
-
-  if(track && eventProc)
+  if(numEvents <= 16)
   {
-    int prevEventPort = 255; // nonsense number to make sure most tracks have port:0
-    SmfEvent* event = track->firstEvent;
+    size_t eventIndex;
 
-    result = true;
-    while(event)
+    for(eventIndex = 1; eventIndex < numEvents; eventIndex++)
     {
-      if((event->port != prevEventPort) && (event->data[0] != SMF_EVENT_META))
+      SmfEvent targetEvent = event[eventIndex];
+      size_t insertIndex = eventIndex;
+
+      while((insertIndex > 0) && (smfEventCompare(&targetEvent, &event[insertIndex - 1]) < 0))
       {
-        byte portChangeMessage[] = { 0xff, 0x21, 0x01, 0 };
-        SmfEvent* portChangeEvent;
+        event[insertIndex] = event[insertIndex - 1];
+        insertIndex--;
+      }
+      event[insertIndex] = targetEvent;
+    }
+  }
+  else
+  {
+    size_t middle = numEvents / 2;
+
+    smfTrackMergeSortEvents(event, work, middle);
+    smfTrackMergeSortEvents(&event[middle], work, numEvents - middle);
+
+    /* halves that are already in order need no merge (the common case) */
+    if(smfEventCompare(&event[middle], &event[middle - 1]) < 0)
+    {
+      size_t leftIndex = 0;
+      size_t rightIndex = middle;
+      size_t mergedIndex = 0;
 
-        portChangeMessage[3] = (byte) event->port;
-        portChangeEvent = smfEventCreate(event->time, event->port, 
-        portChangeMessage, sizeof(portChangeMessage));
-        if(!portChangeEvent)
+      memcpy(work, event, sizeof(SmfEvent) * middle);
+      while((leftIndex < middle) && (rightIndex < numEvents))
+      {
+        if(smfEventCompare(&event[rightIndex], &work[leftIndex]) < 0)
         {
-          result = false;
-          break;
+          event[mergedIndex++] = event[rightIndex++];
         }
-        if(!eventProc(portChangeEvent, customData))
+        else
         {
-          result = false;
-          break;
+          event[mergedIndex++] = work[leftIndex++];
         }
-        smfEventDelete(portChangeEvent);
-        prevEventPort = event->port;
       }
-
-      if(!eventProc(event, customData))
+      while(leftIndex < middle)
       {
-        result = false;
-        break;
+        event[mergedIndex++] = work[leftIndex++];
       }
-      event = event->nextEvent;
     }
   }
-  return result;
 }
 
-int smfTrackGetEndTiming(SmfTrack* track)
+bool smfTrackSortEvents(SmfTrack* track)
 {
-  int endTiming = 0;
+  bool result = true;
 
-  if(track)
+  if(!track->sorted && track->order)
   {
-    SmfEvent* endOfTrack = track->lastEvent;
+    /* the output order is known already, events only have to be moved there */
+    SmfEvent* newEventList = (SmfEvent*) malloc(sizeof(SmfEvent) * track->maxEvents);
 
-    endTiming = endOfTrack->time;
-  }
-  return endTiming;
-}
+    if(newEventList)
+    {
+      size_t position;
 
-int smfTrackSetEndTiming(SmfTrack* track, int newEndTiming)
-{
-  int oldEndTiming = 0;
+      for(position = 0; position < track->numEvents; position++)
+      {
+        newEventList[position] = track->event[track->order[position]];
+      }
+      free(track->event);
+      track->event = newEventList;
+      free(track->order);
+      track->order = NULL;
+      track->sorted = true;
+    }
+  }
 
-  if(track)
+  if(!track->sorted)
   {
-    SmfEvent* endOfTrack = track->lastEvent;
-    int lastEventTiming = endOfTrack->prevEvent 
-      ? endOfTrack->prevEvent->time : 0;
+    SmfEvent* work = (SmfEvent*) malloc(sizeof(SmfEvent) * (track->numEvents / 2 + 1));
 
-    if(newEndTiming >= lastEventTiming)
+    if(work)
     {
-      endOfTrack->time = newEndTiming;
+      smfTrackMergeSortEvents(track->event, work, track->numEvents);
+      track->sorted = true;
+      free(work);
+      free(track->order);
+      track->order = NULL;
     }
-  }
+    else
+    {
+      result = false;
+    }
+  }
+  return result;
+}
+
+/* start keeping the output order, of events that are all in order so far */
+bool smfTrackStartOrder(SmfTrack* track)
+{
+  size_t position;
+
+  track->order = (size_t*) malloc(sizeof(size_t) * track->maxEvents);
+  if(!track->order)
+  {
+    return false;
+  }
+  for(position = 0; position < track->numEvents; position++)
+  {
+    track->order[position] = position;
+  }
+  return true;
+}
+
+/* state of the size measure right before the given place in output order */
+void smfTrackGetSizeInfoAt(SmfTrack* track, size_t position, SmfTrackGetSizeProcInfo* info)
+{
+  info->prevEventTime = 0;
+  info->prevEventPort = SMF_PORT_NONE;
+  info->useRunningStatus = track->runningStatus;
+  info->runningStatus = 0;
+  info->trackSize = 0;
+
+  if(position > 0)
+  {
+    SmfEvent* prevEvent = &track->event[track->order[position - 1]];
+    byte statusByte = smfEventGetData(prevEvent)[0];
+    size_t portPosition = position;
+
+    /* running status is left by the previous event alone, port by the last one that isn't meta */
+    info->prevEventTime = prevEvent->time;
+    info->runningStatus = (info->useRunningStatus && (statusByte < SMF_EVENT_SYSEX)) ? statusByte : 0;
+    while(portPosition > 0)
+    {
+      SmfEvent* portEvent = &track->event[track->order[--portPosition]];
+
+      if(smfEventGetData(portEvent)[0] != SMF_EVENT_META)
+      {
+        info->prevEventPort = portEvent->port;
+        break;
+      }
+    }
+  }
+}
+
+/* place a new event in output order, and measure again only the events whose size it changes:
+   the one right after it, and meta events up to the next port check */
+bool smfTrackInsertOrder(SmfTrack* track, size_t newIndex)
+{
+  SmfEvent* newEvent = &track->event[newIndex];
+  size_t numOrdered = newIndex;
+  size_t position = numOrdered;
+  size_t endPosition;
+  size_t orderIndex;
+  SmfTrackGetSizeProcInfo oldInfo;
+  SmfTrackGetSizeProcInfo newInfo;
+
+  /* later events with the same order stay before it, as in a stable sort */
+  while((position > 0) && (smfEventCompare(newEvent, &track->event[track->order[position - 1]]) < 0))
+  {
+    if(numOrdered - position >= SMF_ORDER_MAX_SHIFT)
+    {
+      return false;
+    }
+    position--;
+  }
+
+  endPosition = position;
+  while((endPosition < numOrdered) && (smfEventGetData(&track->event[track->order[endPosition]])[0] == SMF_EVENT_META))
+  {
+    endPosition++;
+  }
+  if(endPosition < numOrdered)
+  {
+    endPosition++;
+  }
+
+  smfTrackGetSizeInfoAt(track, position, &oldInfo);
+  newInfo = oldInfo;
+  for(orderIndex = position; orderIndex < endPosition; orderIndex++)
+  {
+    smfTrackGetSizeProc(&track->event[track->order[orderIndex]], &oldInfo);
+  }
+
+  memmove(&track->order[position + 1], &track->order[position], sizeof(size_t) * (numOrdered - position));
+  track->order[position] = newIndex;
+  for(orderIndex = position; orderIndex <= endPosition; orderIndex++)
+  {
+    smfTrackGetSizeProc(&track->event[track->order[orderIndex]], &newInfo);
+  }
+
+  track->sizeInfo.trackSize = track->sizeInfo.trackSize - oldInfo.trackSize + newInfo.trackSize;
+  if(endPosition == numOrdered)
+  {
+    /* measured up to the last event, end of track follows on from there */
+    track->sizeInfo.prevEventTime = newInfo.prevEventTime;
+    track->sizeInfo.prevEventPort = newInfo.prevEventPort;
+    track->sizeInfo.runningStatus = newInfo.runningStatus;
+  }
+  return true;
+}
+
+/* size of the track chunk, events are measured only once (or after out of order insertion) */
+size_t smfTrackGetSize(SmfTrack* track)
+{
+  size_t trackSize = 0;
+
+  if(track)
+  {
+    SmfTrackGetSizeProcInfo info;
+
+    if(!track->sizeInfoValid)
+    {
+      smfTrackSortEvents(track);
+      smfTrackMeasureEvents(track);
+      track->sizeInfoValid = track->sorted;
+    }
+
+    /* end of track is measured apart, its timing can be changed at any time */
+    info = track->sizeInfo;
+    smfTrackGetSizeProc(&track->endOfTrack, &info);
+    trackSize = info.trackSize;
+  }
+  return trackSize;
+}
+
+/* the size has to be measured from scratch, before the next output */
+void smfTrackDropSizeInfo(SmfTrack* track)
+{
+  track->sizeInfoValid = false;
+  free(track->order);
+  track->order = NULL;
+}
+
+void smfTrackResetSizeInfo(SmfTrack* track)
+{
+  track->sizeInfo.prevEventTime = 0;
+  track->sizeInfo.prevEventPort = SMF_PORT_NONE;
+  track->sizeInfo.useRunningStatus = track->runningStatus;
+  track->sizeInfo.runningStatus = 0;
+  track->sizeInfo.trackSize = SMF_MTRK_SIZE;
+}
+
+/* measure all events from scratch, same as smfTrackGetSizeProc but delta-times are measured in batches */
+void smfTrackMeasureEvents(SmfTrack* track)
+{
+  SmfTrackGetSizeProcInfo* info = &track->sizeInfo;
+  int timeBuffer[SMF_DELTA_BATCH_SIZE];
+  size_t eventIndex = 0;
+
+  smfTrackResetSizeInfo(track);
+  while(eventIndex < track->numEvents)
+  {
+    size_t numBatchEvents = track->numEvents - eventIndex;
+    size_t batchIndex;
+
+    if(numBatchEvents > SMF_DELTA_BATCH_SIZE)
+    {
+      numBatchEvents = SMF_DELTA_BATCH_SIZE;
+    }
+    for(batchIndex = 0; batchIndex < numBatchEvents; batchIndex++)
+    {
+      timeBuffer[batchIndex] = track->event[eventIndex + batchIndex].time;
+    }
+    info->trackSize += smfGetDeltaTimeSizes(timeBuffer, numBatchEvents, info->prevEventTime, NULL);
+    info->prevEventTime = timeBuffer[numBatchEvents - 1];
+
+    for(batchIndex = 0; batchIndex < numBatchEvents; batchIndex++)
+    {
+      SmfEvent* event = &track->event[eventIndex + batchIndex];
+      size_t statusSkip = 0;
+
+      /* port prefix takes over the delta-time, event itself follows with zero delta */
+      if(smfEventChangesPort(event, &info->prevEventPort))
+      {
+        info->trackSize += 1 + SMF_PORT_PREFIX_SIZE;
+        info->runningStatus = 0;
+      }
+      if(info->useRunningStatus)
+      {
+        statusSkip = smfEventGetRunningStatusSkip(event, &info->runningStatus);
+      }
+      info->trackSize += event->size - statusSkip;
+    }
+    eventIndex += numBatchEvents;
+  }
+}
+
+bool smfTrackGetSizeProc(SmfEvent* event, void* customData)
+{
+  SmfTrackGetSizeProcInfo* info = (SmfTrackGetSizeProcInfo*) customData;
+  size_t statusSkip = 0;
+  int deltaTime;
+
+  if(smfEventChangesPort(event, &info->prevEventPort))
+  {
+    deltaTime = event->time - info->prevEventTime;
+    info->trackSize += smfGetVarLengthSize(deltaTime) + SMF_PORT_PREFIX_SIZE;
+    info->prevEventTime = event->time;
+    info->runningStatus = 0;
+  }
+  if(info->useRunningStatus)
+  {
+    statusSkip = smfEventGetRunningStatusSkip(event, &info->runningStatus);
+  }
+
+  deltaTime = event->time - info->prevEventTime;
+  info->trackSize += smfGetVarLengthSize(deltaTime);
+  info->trackSize += event->size - statusSkip;
+  info->prevEventTime = event->time;
+  return true;
+}
+
+size_t smfTrackWrite(SmfTrack* track, byte* buffer, size_t bufferSize)
+{
+  size_t transferedSize = 0;
+
+  if(track && buffer && bufferSize)
+  {
+    byte MTrkData[SMF_MTRK_SIZE] = { 'M', 'T', 'r', 'k', 0, 0, 0, 0 };
+    size_t trackSize = smfTrackGetSize(track);
+
+    smfWriteByte(4, (unsigned int) (trackSize - SMF_MTRK_SIZE), &MTrkData[4], 4);
+    if(bufferSize >= SMF_MTRK_SIZE)
+    {
+      SmfTrackWriteProcInfo info;
+
+      memcpy(&buffer[transferedSize], MTrkData, SMF_MTRK_SIZE);
+      transferedSize += SMF_MTRK_SIZE;
+
+      info.prevEventTime = 0;
+      info.prevEventPort = SMF_PORT_NONE;
+      info.useRunningStatus = track->runningStatus;
+      info.runningStatus = 0;
+      info.buffer = buffer;
+      info.bufferSize = bufferSize;
+      info.transferedSize = transferedSize;
+      smfTrackEnumEvents(track, smfTrackWriteProc, &info);
+      transferedSize = info.transferedSize;
+    }
+    else
+    {
+      memcpy(&buffer[transferedSize], MTrkData, bufferSize - transferedSize);
+      transferedSize = bufferSize;
+    }
+  }
+  return transferedSize;
+}
+
+bool smfTrackWriteProc(SmfEvent* event, const byte* deltaTimeSize, size_t numEvents, void* customData)
+{
+  SmfTrackWriteProcInfo* info = (SmfTrackWriteProcInfo*) customData;
+  size_t eventIndex;
+
+  for(eventIndex = 0; eventIndex < numEvents; eventIndex++)
+  {
+    if(!smfTrackWriteEvent(info, &event[eventIndex], deltaTimeSize[eventIndex]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool smfTrackWriteEvent(SmfTrackWriteProcInfo* info, SmfEvent* event, size_t deltaTimeSize)
+{
+  bool result = true;
+  size_t statusSkip = 0;
+
+  /* port prefix takes over the delta-time, event itself follows with zero delta */
+  if(smfEventChangesPort(event, &info->prevEventPort))
+  {
+    byte portPrefix[SMF_PORT_PREFIX_SIZE] = { 0xff, 0x21, 0x01, 0 };
+
+    portPrefix[3] = (byte) event->port;
+    result = smfTrackWriteMessage(info, event->time, deltaTimeSize, portPrefix, SMF_PORT_PREFIX_SIZE);
+    info->runningStatus = 0;
+    deltaTimeSize = 1;
+  }
+  if(info->useRunningStatus)
+  {
+    statusSkip = smfEventGetRunningStatusSkip(event, &info->runningStatus);
+  }
+  if(result)
+  {
+    result = smfTrackWriteMessage(info, event->time, deltaTimeSize, &smfEventGetData(event)[statusSkip], event->size - statusSkip);
+  }
+  return result;
+}
+
+/* write a message after its delta-time, whose size is measured beforehand */
+bool smfTrackWriteMessage(SmfTrackWriteProcInfo* info, int time, size_t deltaTimeSize, const byte* data, size_t dataSize)
+{
+  bool result = false;
+  byte* buffer = info->buffer;
+  size_t bufferSize = info->bufferSize;
+  size_t transferedSize = info->transferedSize;
+  int deltaTime = time - info->prevEventTime;
+
+  if(bufferSize >= (transferedSize + deltaTimeSize))
+  {
+    smfWriteVarLength(deltaTime, &buffer[transferedSize], deltaTimeSize);
+    transferedSize += deltaTimeSize;
+
+    if(bufferSize >= (transferedSize + dataSize))
+    {
+      memcpy(&buffer[transferedSize], data, dataSize);
+      transferedSize += dataSize;
+      result = true;
+    }
+    else
+    {
+      memcpy(&buffer[transferedSize], data, bufferSize - transferedSize);
+      transferedSize = bufferSize;
+    }
+  }
+  else
+  {
+    smfWriteVarLength(deltaTime, &buffer[transferedSize], bufferSize - transferedSize);
+    transferedSize = bufferSize;
+  }
+
+  info->prevEventTime = time;
+  info->transferedSize = transferedSize;
+  return result;
+}
+
+/* write a track to sink in bounded chunks, the chunk length is computed beforehand */
+size_t smfTrackWriteToSink(SmfTrack* track, SmfWriteProc* writeProc, void* userData)
+{
+  size_t transferedSize = 0;
+
+  if(track && writeProc)
+  {
+    byte MTrkData[SMF_MTRK_SIZE] = { 'M', 'T', 'r', 'k', 0, 0, 0, 0 };
+    size_t trackSize = smfTrackGetSize(track);
+
+    smfWriteByte(4, (unsigned int) (trackSize - SMF_MTRK_SIZE), &MTrkData[4], 4);
+    transferedSize = smfTrackWriteSinkEvents(track, MTrkData, writeProc, userData);
+  }
+  return transferedSize;
+}
+
+/* write a track to stream in one pass, the chunk length is patched afterwards */
+size_t smfTrackWriteStream(SmfTrack* track, FILE* stream)
+{
+  size_t transferedSize = 0;
+
+  if(track && stream)
+  {
+    byte MTrkData[SMF_MTRK_SIZE] = { 'M', 'T', 'r', 'k', 0, 0, 0, 0 };
+    long MTrkOffset = ftell(stream);
+    size_t trackSize = 0;
+
+    if(MTrkOffset >= 0)
+    {
+      trackSize = smfTrackWriteSinkEvents(track, MTrkData, smfFileWriteProc, stream);
+    }
+    if(trackSize != 0)
+    {
+      long endOffset = ftell(stream);
+
+      smfWriteByte(4, (unsigned int) (trackSize - SMF_MTRK_SIZE), &MTrkData[4], 4);
+      if((endOffset >= 0) 
+          && (fseek(stream, MTrkOffset + 4, SEEK_SET) == 0) 
+          && (fwrite(&MTrkData[4], 4, 1, stream) == 1) 
+          && (fseek(stream, endOffset, SEEK_SET) == 0))
+      {
+        transferedSize = trackSize;
+      }
+    }
+  }
+  return transferedSize;
+}
+
+/* write MTrk header and events of a track to sink, return the whole chunk size (0 on error) */
+size_t smfTrackWriteSinkEvents(SmfTrack* track, const byte* MTrkData, SmfWriteProc* writeProc, void* userData)
+{
+  size_t transferedSize = 0;
+  SmfTrackWriteSinkProcInfo info;
+
+  info.prevEventTime = 0;
+  info.prevEventPort = SMF_PORT_NONE;
+  info.useRunningStatus = track->runningStatus;
+  info.runningStatus = 0;
+  info.writeProc = writeProc;
+  info.userData = userData;
+  info.transferedSize = 0;
+  info.bufferedSize = 0;
+  if(smfTrackWriteSinkData(&info, MTrkData, SMF_MTRK_SIZE) 
+      && smfTrackEnumEvents(track, smfTrackWriteSinkProc, &info) 
+      && smfTrackWriteSinkFlush(&info))
+  {
+    transferedSize = info.transferedSize;
+  }
+  return transferedSize;
+}
+
+bool smfTrackWriteSinkProc(SmfEvent* event, const byte* deltaTimeSize, size_t numEvents, void* customData)
+{
+  SmfTrackWriteSinkProcInfo* info = (SmfTrackWriteSinkProcInfo*) customData;
+  size_t eventIndex;
+
+  for(eventIndex = 0; eventIndex < numEvents; eventIndex++)
+  {
+    if(!smfTrackWriteSinkEvent(info, &event[eventIndex], deltaTimeSize[eventIndex]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool smfTrackWriteSinkEvent(SmfTrackWriteSinkProcInfo* info, SmfEvent* event, size_t deltaTimeSize)
+{
+  bool result = true;
+  size_t statusSkip = 0;
+
+  if(smfEventChangesPort(event, &info->prevEventPort))
+  {
+    byte portPrefix[SMF_PORT_PREFIX_SIZE] = { 0xff, 0x21, 0x01, 0 };
+
+    portPrefix[3] = (byte) event->port;
+    result = smfTrackWriteSinkMessage(info, event->time, deltaTimeSize, portPrefix, SMF_PORT_PREFIX_SIZE);
+    info->runningStatus = 0;
+    deltaTimeSize = 1;
+  }
+  if(info->useRunningStatus)
+  {
+    statusSkip = smfEventGetRunningStatusSkip(event, &info->runningStatus);
+  }
+  if(result)
+  {
+    result = smfTrackWriteSinkMessage(info, event->time, deltaTimeSize, &smfEventGetData(event)[statusSkip], event->size - statusSkip);
+  }
+  return result;
+}
+
+bool smfTrackWriteSinkMessage(SmfTrackWriteSinkProcInfo* info, int time, size_t deltaTimeSize, const byte* data, size_t dataSize)
+{
+  bool result = true;
+  byte deltaTime[SMF_VARLEN_MAX];
+
+  smfWriteVarLength(time - info->prevEventTime, deltaTime, deltaTimeSize);
+  result = smfTrackWriteSinkData(info, deltaTime, deltaTimeSize) 
+    && smfTrackWriteSinkData(info, data, dataSize);
+  info->prevEventTime = time;
+  return result;
+}
+
+/* put data into the chunk buffer, handing full chunks to the sink */
+bool smfTrackWriteSinkData(SmfTrackWriteSinkProcInfo* info, const byte* data, size_t dataSize)
+{
+  bool result = true;
+
+  info->transferedSize += dataSize;
+  while(result && dataSize)
+  {
+    size_t sizeToTransfer = SMF_STREAM_BUFFER_SIZE - info->bufferedSize;
+
+    if(sizeToTransfer > dataSize)
+    {
+      sizeToTransfer = dataSize;
+    }
+    memcpy(&info->buffer[info->bufferedSize], data, sizeToTransfer);
+    info->bufferedSize += sizeToTransfer;
+    data += sizeToTransfer;
+    dataSize -= sizeToTransfer;
+
+    if(info->bufferedSize == SMF_STREAM_BUFFER_SIZE)
+    {
+      result = smfTrackWriteSinkFlush(info);
+    }
+  }
+  return result;
+}
+
+bool smfTrackWriteSinkFlush(SmfTrackWriteSinkProcInfo* info)
+{
+  bool result = true;
+
+  if(info->bufferedSize)
+  {
+    result = info->writeProc(info->buffer, info->bufferedSize, info->userData);
+    info->bufferedSize = 0;
+  }
+  return result;
+}
+
+/* sink which writes to FILE* */
+bool smfFileWriteProc(const byte* data, size_t dataSize, void* userData)
+{
+  return (fwrite(data, dataSize, 1, (FILE*) userData) == 1);
+}
+
+/* hand sorted events to eventProc in batches, along with the sizes of their delta-times */
+bool smfTrackEnumEvents(SmfTrack* track, SmfTrackEnumEventsProc* eventProc, void* customData)
+{
+  bool result = false;
+
+  if(track && eventProc && smfTrackSortEvents(track))
+  {
+    int timeBuffer[SMF_DELTA_BATCH_SIZE];
+    byte deltaTimeSize[SMF_DELTA_BATCH_SIZE];
+    int prevEventTime = 0;
+    size_t eventIndex = 0;
+
+    result = true;
+    while(result && (eventIndex < track->numEvents))
+    {
+      size_t numBatchEvents = track->numEvents - eventIndex;
+      size_t batchIndex;
+
+      if(numBatchEvents > SMF_DELTA_BATCH_SIZE)
+      {
+        numBatchEvents = SMF_DELTA_BATCH_SIZE;
+      }
+      for(batchIndex = 0; batchIndex < numBatchEvents; batchIndex++)
+      {
+        timeBuffer[batchIndex] = track->event[eventIndex + batchIndex].time;
+      }
+      smfGetDeltaTimeSizes(timeBuffer, numBatchEvents, prevEventTime, deltaTimeSize);
+      prevEventTime = timeBuffer[numBatchEvents - 1];
+
+      result = eventProc(&track->event[eventIndex], deltaTimeSize, numBatchEvents, customData);
+      eventIndex += numBatchEvents;
+    }
+    if(result)
+    {
+      deltaTimeSize[0] = (byte) smfGetVarLengthSize((unsigned int) (track->endOfTrack.time - prevEventTime));
+      result = eventProc(&track->endOfTrack, deltaTimeSize, 1, customData);
+    }
+  }
+  return result;
+}
+
+/* number of leading status bytes omitted by running status (0 or 1) */
+size_t smfEventGetRunningStatusSkip(SmfEvent* event, byte* runningStatus)
+{
+  size_t statusSkip = 0;
+  byte statusByte = smfEventGetData(event)[0];
+
+  if(statusByte < SMF_EVENT_SYSEX)
+  {
+    if(statusByte == *runningStatus)
+    {
+      statusSkip = 1;
+    }
+    *runningStatus = statusByte;
+  }
+  else
+  {
+    /* sysex and meta events cancel running status */
+    *runningStatus = 0;
+  }
+  return statusSkip;
+}
+
+/* tell if a port prefix has to be put before the event */
+bool smfEventChangesPort(SmfEvent* event, int* prevEventPort)
+{
+  bool portChanged = false;
+
+  if(((int) event->port != *prevEventPort) && (smfEventGetData(event)[0] != SMF_EVENT_META))
+  {
+    *prevEventPort = event->port;
+    portChanged = true;
+  }
+  return portChanged;
+}
+
+int smfTrackGetEndTiming(SmfTrack* track)
+{
+  int endTiming = 0;
+
+  if(track)
+  {
+    endTiming = track->endOfTrack.time;
+  }
+  return endTiming;
+}
+
+int smfTrackSetEndTiming(SmfTrack* track, int newEndTiming)
+{
+  int oldEndTiming = 0;
+
+  if(track)
+  {
+    if(newEndTiming >= track->lastEventTiming)
+    {
+      track->endOfTrack.time = newEndTiming;
+    }
+  }
   return oldEndTiming;
 }
 
+bool smfTrackSetRunningStatus(SmfTrack* track, bool runningStatus)
+{
+  bool oldRunningStatus = false;
+
+  if(track)
+  {
+    oldRunningStatus = track->runningStatus;
+    track->runningStatus = runningStatus;
+    if(runningStatus != oldRunningStatus)
+    {
+      smfTrackDropSizeInfo(track);
+    }
+  }
+  return oldRunningStatus;
+}
+
 
 bool smfReallocTrack(Smf* seq, int newNumTracks);
 
@@ -545,16 +1456,18 @@ Smf* smfCreate(void)
 
   if(newSeq)
   {
+    newSeq->arena = smfArenaCreate();
     newSeq->track = (SmfTrack**) malloc(sizeof(SmfTrack*));
-    if(newSeq->track)
+    if(newSeq->arena && newSeq->track)
     {
-      newSeq->track[0] = smfTrackCreate();
+      newSeq->track[0] = smfTrackCreateInArena(newSeq->arena);
       if(newSeq->track[0])
       {
         newSeq->numTracks++;
       }
       else
       {
+        smfArenaDelete(newSeq->arena);
         free(newSeq->track);
         free(newSeq);
         newSeq = NULL;
@@ -562,6 +1475,8 @@ Smf* smfCreate(void)
     }
     else
     {
+      smfArenaDelete(newSeq->arena);
+      free(newSeq->track);
       free(newSeq);
       newSeq = NULL;
     }
@@ -580,6 +1495,8 @@ void smfDelete(Smf* seq)
     {
       smfTrackDelete(seq->track[trackIndex]);
     }
+    smfArenaDelete(seq->arena);
+    free(seq->track);
     free(seq);
   }
 }
@@ -596,18 +1513,19 @@ Smf* smfCopy(Smf* seq)
 
       for(trackIndex = 0; trackIndex < seq->numTracks; trackIndex++)
       {
-        SmfTrack* newTrack = smfTrackCopy(seq->track[trackIndex]);
-        if(!newTrack)
+        if(!smfTrackCopyEvents(newSeq->track[trackIndex], seq->track[trackIndex]))
         {
           smfDelete(newSeq);
           newSeq = NULL;
           break;
         }
-        smfTrackDelete(newSeq->track[trackIndex]);
-        newSeq->track[trackIndex] = newTrack;
       }
 
-      smfSetTimebase(newSeq, seq->timebase);
+      if(newSeq)
+      {
+        smfSetTimebase(newSeq, seq->timebase);
+        smfSetRunningStatus(newSeq, seq->runningStatus);
+      }
     }
     else
     {
@@ -691,6 +1609,70 @@ size_t smfWrite(Smf* seq, byte* buffer, size_t bufferSize)
   return transferedSize;
 }
 
+/* write standard midi to stream, traversing each track only once */
+size_t smfWriteStream(Smf* seq, FILE* stream)
+{
+  size_t transferedSize = 0;
+
+  if(seq && stream)
+  {
+    byte MThdData[SMF_MTHD_SIZE] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 0, 0, 0 };
+
+    smfWriteByte(2, seq->numTracks, &MThdData[10], 2);
+    smfWriteByte(2, seq->timebase, &MThdData[12], 2);
+    if(fwrite(MThdData, SMF_MTHD_SIZE, 1, stream) == 1)
+    {
+      int trackIndex;
+
+      transferedSize += SMF_MTHD_SIZE;
+      for(trackIndex = 0; trackIndex < seq->numTracks; trackIndex++)
+      {
+        size_t trackSize = smfTrackWriteStream(seq->track[trackIndex], stream);
+
+        if(trackSize == 0)
+        {
+          transferedSize = 0;
+          break;
+        }
+        transferedSize += trackSize;
+      }
+    }
+  }
+  return transferedSize;
+}
+
+/* write standard midi to sink procedure, chunk by chunk */
+size_t smfWriteToSink(Smf* seq, SmfWriteProc* writeProc, void* userData)
+{
+  size_t transferedSize = 0;
+
+  if(seq && writeProc)
+  {
+    byte MThdData[SMF_MTHD_SIZE] = { 'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 0, 0, 0 };
+
+    smfWriteByte(2, seq->numTracks, &MThdData[10], 2);
+    smfWriteByte(2, seq->timebase, &MThdData[12], 2);
+    if(writeProc(MThdData, SMF_MTHD_SIZE, userData))
+    {
+      int trackIndex;
+
+      transferedSize += SMF_MTHD_SIZE;
+      for(trackIndex = 0; trackIndex < seq->numTracks; trackIndex++)
+      {
+        size_t trackSize = smfTrackWriteToSink(seq->track[trackIndex], writeProc, userData);
+
+        if(trackSize == 0)
+        {
+          transferedSize = 0;
+          break;
+        }
+        transferedSize += trackSize;
+      }
+    }
+  }
+  return transferedSize;
+}
+
 int smfSetTimebase(Smf* seq, int newTimebase)
 {
   int oldTimebase = 0;
@@ -723,6 +1705,80 @@ int smfSetEndTimingOfTrack(Smf* seq, int track, int newEndTiming)
   return oldEndTiming;
 }
 
+/* omit repeated status bytes of channel messages on output */
+bool smfSetRunningStatus(Smf* seq, bool runningStatus)
+{
+  bool oldRunningStatus = false;
+
+  if(seq)
+  {
+    int trackIndex;
+
+    oldRunningStatus = seq->runningStatus;
+    seq->runningStatus = runningStatus;
+    for(trackIndex = 0; trackIndex < seq->numTracks; trackIndex++)
+    {
+      smfTrackSetRunningStatus(seq->track[trackIndex], runningStatus);
+    }
+  }
+  return oldRunningStatus;
+}
+
+/* add all events of srcTrack (possibly from another smf) to the track */
+bool smfAttachTrack(Smf* seq, int track, SmfTrack* srcTrack)
+{
+  bool result = false;
+
+  if(seq && srcTrack)
+  {
+    bool allocResult = true;
+
+    if(track >= seq->numTracks)
+    {
+      allocResult = smfReallocTrack(seq, track + 1);
+    }
+    if(allocResult)
+    {
+      SmfTrack* destTrack = seq->track[track];
+      int endTiming = smfTrackGetEndTiming(destTrack);
+
+      if(smfTrackGetEndTiming(srcTrack) > endTiming)
+      {
+        endTiming = smfTrackGetEndTiming(srcTrack);
+      }
+
+      if(destTrack->numEvents == 0)
+      {
+        /* a whole track in bulk, output settings are of this smf */
+        result = smfTrackCopyEvents(destTrack, srcTrack);
+        if(destTrack->runningStatus != seq->runningStatus)
+        {
+          destTrack->runningStatus = seq->runningStatus;
+          smfTrackDropSizeInfo(destTrack);
+        }
+      }
+      else
+      {
+        size_t eventIndex;
+
+        result = true;
+        for(eventIndex = 0; eventIndex < srcTrack->numEvents; eventIndex++)
+        {
+          SmfEvent* event = &srcTrack->event[eventIndex];
+
+          if(!smfTrackInsertEvent(destTrack, event->time, event->port, smfEventGetData(event), event->size))
+          {
+            result = false;
+            break;
+          }
+        }
+      }
+      smfTrackSetEndTiming(destTrack, endTiming);
+    }
+  }
+  return result;
+}
+
 bool smfReallocTrack(Smf* seq, int newNumTracks)
 {
   bool result = false;
@@ -741,7 +1797,8 @@ bool smfReallocTrack(Smf* seq, int newNumTracks)
         seq->track = newTracks;
         for(trackIndex = seq->numTracks; trackIndex < newNumTracks; trackIndex++)
         {
-          seq->track[trackIndex] = smfTrackCreate();
+          seq->track[trackIndex] = smfTrackCreateInArena(seq->arena);
+          smfTrackSetRunningStatus(seq->track[trackIndex], seq->runningStatus);
           seq->numTracks++;
           if(!seq->track[trackIndex])
           {
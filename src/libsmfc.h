@@ -7,6 +7,7 @@
 #define LIBSMFC_H
 
 #include <stddef.h>
+#include <stdio.h>
 
 #if !defined(bool) && !defined(__cplusplus)
   typedef int bool;
@@ -21,45 +22,99 @@
   typedef signed char sbyte;
 #endif /* !sbyte */
 
-unsigned int smfReadVarLength(byte* buffer, size_t bufferSize);
+unsigned int smfReadVarLength(const byte* buffer, size_t bufferSize);
 size_t smfWriteByte(size_t sizeToTransfer, unsigned int value, byte* buffer, size_t bufferSize);
 size_t smfGetVarLengthSize(unsigned int value);
 size_t smfWriteVarLength(unsigned int value, byte* buffer, size_t bufferSize);
+size_t smfGetDeltaTimeSizes(const int* time, size_t numTimes, int prevTime, byte* deltaTimeSize);
 
 
+#define SMF_EVENT_INLINE_SIZE   8
+#define SMF_EVENT_SIZE_MAX      0xffffff
+
+typedef struct TagSmfArenaBlock SmfArenaBlock;
+struct TagSmfArenaBlock
+{
+  SmfArenaBlock*  nextBlock;
+  size_t          blockSize;
+  size_t          usedSize;
+};
+
+typedef struct TagSmfArena
+{
+  SmfArenaBlock*  firstBlock;
+} SmfArena;
+
+SmfArena* smfArenaCreate(void);
+void smfArenaDelete(SmfArena* arena);
+void* smfArenaAlloc(SmfArena* arena, size_t size);
+
+
+typedef bool (SmfWriteProc)(const byte* data, size_t dataSize, void* userData);
+
+
+/* 16-byte record, payloads up to 8 bytes are stored in place */
 typedef struct TagSmfEvent SmfEvent;
 struct TagSmfEvent
 {
-  byte*       data;
-  size_t      size;
-  int         time;
-  int         port;
-  SmfEvent*   prevEvent;
-  SmfEvent*   nextEvent;
+  int           time;
+  unsigned int  size : 24;
+  unsigned int  port : 8;
+  union
+  {
+    byte        inlineData[SMF_EVENT_INLINE_SIZE];
+    byte*       data;
+  } payload;
 };
 
 SmfEvent* smfEventCreate(int time, int port, const byte* data, size_t dataSize);
 void smfEventDelete(SmfEvent* event);
+byte* smfEventGetData(SmfEvent* event);
 SmfEvent* smfEventCopy(SmfEvent* event);
 size_t smfEventGetSize(SmfEvent* event);
 size_t smfEventWrite(SmfEvent* event, byte* buffer, size_t bufferSize);
 int smfEventCompare(SmfEvent* event, SmfEvent* targetEvent);
 
 
+/* running state of the encoded track size, kept up to date on append */
+typedef struct TagSmfTrackGetSizeProcInfo
+{
+  int prevEventTime;
+  int prevEventPort;
+  bool useRunningStatus;
+  byte runningStatus;
+  size_t trackSize;
+} SmfTrackGetSizeProcInfo;
+
 typedef struct TagSmfTrack
 {
-  SmfEvent*   firstEvent;
-  SmfEvent*   lastEvent;
+  SmfEvent*   event;
+  size_t      numEvents;
+  size_t      maxEvents;
+  bool        sorted;
+  int         lastEventTiming;
+  SmfEvent    endOfTrack;
+  SmfArena*   arena;
+  bool        ownsArena;
+  bool        runningStatus;
+  SmfTrackGetSizeProcInfo sizeInfo;
+  bool        sizeInfoValid;
+  size_t*     order;          /* event indices in output order, kept while events come out of order */
 } SmfTrack;
 
 SmfTrack* smfTrackCreate(void);
+SmfTrack* smfTrackCreateInArena(SmfArena* arena);
 void smfTrackDelete(SmfTrack* track);
 SmfTrack* smfTrackCopy(SmfTrack* track);
 bool smfTrackInsertEvent(SmfTrack* track, int time, int port, const byte* data, size_t dataSize);
+bool smfTrackRepeatEvents(SmfTrack* track, size_t firstEvent, size_t numEvents, int timeShift);
 size_t smfTrackGetSize(SmfTrack* track);
 size_t smfTrackWrite(SmfTrack* track, byte* buffer, size_t bufferSize);
+size_t smfTrackWriteStream(SmfTrack* track, FILE* stream);
+size_t smfTrackWriteToSink(SmfTrack* track, SmfWriteProc* writeProc, void* userData);
 int smfTrackGetEndTiming(SmfTrack* track);
 int smfTrackSetEndTiming(SmfTrack* track, int newEndTiming);
+bool smfTrackSetRunningStatus(SmfTrack* track, bool runningStatus);
 
 
 typedef struct TagSmf
@@ -67,6 +122,8 @@ typedef struct TagSmf
   int numTracks;
   int timebase;
   SmfTrack** track;
+  SmfArena* arena;
+  bool runningStatus;
 } Smf;
 
 Smf* smfCreate(void);
@@ -75,7 +132,11 @@ Smf* smfCopy(Smf* seq);
 bool smfInsertEvent(Smf* seq, int time, int port, int track, const byte* data, size_t dataSize);
 size_t smfGetSize(Smf* seq);
 size_t smfWrite(Smf* seq, byte* buffer, size_t bufferSize);
+size_t smfWriteStream(Smf* seq, FILE* stream);
+size_t smfWriteToSink(Smf* seq, SmfWriteProc* writeProc, void* userData);
 int smfSetTimebase(Smf* seq, int newTimebase);
 int smfSetEndTimingOfTrack(Smf* seq, int track, int newEndTiming);
+bool smfSetRunningStatus(Smf* seq, bool runningStatus);
+bool smfAttachTrack(Smf* seq, int track, SmfTrack* srcTrack);
 
 #endif /* !LIBSMFC_H */
@@ -22,23 +22,21 @@
 #define SMF_EVENT_SYSEXLITE     0xf7
 #define SMF_EVENT_META          0xff
 
+#define SMF_FILE_BUFFER_SIZE    0x10000
+
 bool smfWriteFile(Smf* seq, const char* filename)
 {
   bool result = false;
-  size_t seqSize = smfGetSize(seq);
   FILE* fileWriter = fopen(filename, "wb");
 
   if(fileWriter)
   {
-    byte* buffer = (byte*) malloc(seqSize);
-
-    if(buffer)
+    setvbuf(fileWriter, NULL, _IOFBF, SMF_FILE_BUFFER_SIZE);
+    result = (smfWriteStream(seq, fileWriter) != 0);
+    if(fclose(fileWriter) != 0)
     {
-      smfWrite(seq, buffer, seqSize);
-      result = (bool) fwrite(buffer, seqSize, 1, fileWriter);
-      free(buffer);
+      result = false;
     }
-    fclose(fileWriter);
   }
   return result;
 }
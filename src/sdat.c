@@ -0,0 +1,289 @@
+/**
+ * sdat.c: find sseq in nds sound data archive (SDAT)
+ * sequences are read in place, they are never copied out of the archive
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sdat.h"
+
+#define SDAT_HEADER_SIZE        0x40
+#define SDAT_SYMB_OFFSET        0x10    /* offsets of blocks in header */
+#define SDAT_INFO_OFFSET        0x18
+#define SDAT_FAT_OFFSET         0x20
+#define SDAT_BLOCK_HEADER_SIZE  0x0c
+#define SDAT_FAT_ENTRY_SIZE     0x10
+#define SDAT_RECORD_SEQ         0       /* first record of SYMB and INFO */
+
+Sdat* sdatCreateOnData(const byte* sdat, size_t sdatSize, int storage);
+bool sdatReadSeqs(Sdat* sdat);
+bool sdatInRange(const Sdat* sdat, size_t offset, size_t size);
+size_t sdatFindBlock(const Sdat* sdat, size_t headerOffset, const char* magic);
+size_t sdatFindRecord(const Sdat* sdat, size_t blockOffset, int recordType);
+void sdatReadName(const Sdat* sdat, size_t nameOffset, char* name);
+
+/* check sdat signature */
+bool sdatIsSdat(const byte* data, size_t dataSize)
+{
+	return (dataSize >= SDAT_HEADER_SIZE) && (memcmp(data, "SDAT", 4) == 0);
+}
+
+/* create sdat object on archive data, which is released by sdatDelete as storage says */
+Sdat* sdatCreateOnData(const byte* sdat, size_t sdatSize, int storage)
+{
+	Sdat* newSdat = NULL;
+
+	if(sdatIsSdat(sdat, sdatSize))
+	{
+		newSdat = (Sdat*) calloc(1, sizeof(Sdat));
+		if(newSdat)
+		{
+			newSdat->sdat = sdat;
+			newSdat->sdatSize = sdatSize;
+			newSdat->sdatStorage = storage;
+			if(!sdatReadSeqs(newSdat))
+			{
+				free(newSdat);
+				newSdat = NULL;
+			}
+		}
+	}
+	return newSdat;
+}
+
+/* create sdat object, sdat is borrowed and must outlive the object */
+Sdat* sdatCreateBorrowed(const byte* sdat, size_t sdatSize)
+{
+	return sdatCreateOnData(sdat, sdatSize, SSEQ2MID_STORAGE_BORROWED);
+}
+
+/* create sdat object from file, mapped read-only where possible */
+Sdat* sdatCreateFromFile(const char* filename)
+{
+	Sdat* newSdat = NULL;
+	size_t sdatSize;
+	int storage;
+	const byte* sdat = sseq2midLoadFile(filename, &sdatSize, &storage);
+
+	if(sdat)
+	{
+		newSdat = sdatCreateOnData(sdat, sdatSize, storage);
+		if(!newSdat)
+		{
+			sseq2midReleaseData(sdat, sdatSize, storage);
+		}
+	}
+	return newSdat;
+}
+
+/* delete sdat object */
+void sdatDelete(Sdat* sdat)
+{
+	if(sdat)
+	{
+		free(sdat->seq);
+		sseq2midReleaseData(sdat->sdat, sdat->sdatSize, sdat->sdatStorage);
+		free(sdat);
+	}
+}
+
+/* create sseq2mid object on a sequence of sdat, which must outlive the object */
+Sseq2mid* sdatCreateSseq2mid(Sdat* sdat, int seqIndex, bool modifyChOrder)
+{
+	if(!sdat || (seqIndex < 0) || (seqIndex >= sdat->numSeqs))
+	{
+		return NULL;
+	}
+	return sseq2midCreateBorrowed(&sdat->sdat[sdat->seq[seqIndex].offset], sdat->seq[seqIndex].size, modifyChOrder);
+}
+
+/* match name against pattern of '*' (any string) and '?' (any character) */
+bool sdatMatchName(const char* name, const char* pattern)
+{
+	const char* starPattern = NULL;
+	const char* starName = NULL;
+
+	while(*name != '\0')
+	{
+		if(*pattern == '*')
+		{
+			pattern++;
+			starPattern = pattern;
+			starName = name;
+		}
+		else if((*pattern == '?') || (*pattern == *name))
+		{
+			pattern++;
+			name++;
+		}
+		else if(starPattern)
+		{
+			/* let the last star take one more character */
+			starName++;
+			pattern = starPattern;
+			name = starName;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	while(*pattern == '*')
+	{
+		pattern++;
+	}
+	return (*pattern == '\0');
+}
+
+/* list sequences from INFO, FAT and SYMB, broken entries are left out */
+bool sdatReadSeqs(Sdat* sdat)
+{
+	size_t symbOffset = sdatFindBlock(sdat, SDAT_SYMB_OFFSET, "SYMB");
+	size_t infoOffset = sdatFindBlock(sdat, SDAT_INFO_OFFSET, "INFO");
+	size_t fatOffset = sdatFindBlock(sdat, SDAT_FAT_OFFSET, "FAT ");
+	size_t seqInfoOffset;
+	size_t seqSymbOffset = 0;
+	unsigned int numSeqInfos;
+	unsigned int numSeqSymbs = 0;
+	unsigned int numFiles;
+	unsigned int infoIndex;
+
+	if(!infoOffset || !fatOffset)
+	{
+		return false;
+	}
+	seqInfoOffset = sdatFindRecord(sdat, infoOffset, SDAT_RECORD_SEQ);
+	if(!seqInfoOffset)
+	{
+		return false;
+	}
+	numSeqInfos = getU4LitFrom(&sdat->sdat[seqInfoOffset]);
+	if(symbOffset)
+	{
+		seqSymbOffset = sdatFindRecord(sdat, symbOffset, SDAT_RECORD_SEQ);
+		if(seqSymbOffset)
+		{
+			numSeqSymbs = getU4LitFrom(&sdat->sdat[seqSymbOffset]);
+		}
+	}
+
+	numFiles = getU4LitFrom(&sdat->sdat[fatOffset + 8]);
+	if((numFiles > sdat->sdatSize / SDAT_FAT_ENTRY_SIZE)
+		|| !sdatInRange(sdat, fatOffset + SDAT_BLOCK_HEADER_SIZE, numFiles * SDAT_FAT_ENTRY_SIZE))
+	{
+		return false;
+	}
+
+	sdat->seq = (SdatSeq*) calloc(numSeqInfos ? numSeqInfos : 1, sizeof(SdatSeq));
+	if(!sdat->seq)
+	{
+		return false;
+	}
+	sdat->numSeqs = 0;
+
+	for(infoIndex = 0; infoIndex < numSeqInfos; infoIndex++)
+	{
+		SdatSeq* seq = &sdat->seq[sdat->numSeqs];
+		size_t entryOffset = getU4LitFrom(&sdat->sdat[seqInfoOffset + 4 + infoIndex * 4]);
+		size_t fatEntryOffset;
+		unsigned int fileId;
+
+		/* INFO entry: u16 file id, u16, u16 bank, u8 volume, u8 cpr, u8 ppr, u8 player */
+		if(!entryOffset || !sdatInRange(sdat, infoOffset + entryOffset, 2))
+		{
+			continue;
+		}
+		fileId = getU2LitFrom(&sdat->sdat[infoOffset + entryOffset]);
+		if(fileId >= numFiles)
+		{
+			continue;
+		}
+
+		/* FAT entry: u32 offset, u32 size, 8 bytes reserved */
+		fatEntryOffset = fatOffset + SDAT_BLOCK_HEADER_SIZE + fileId * SDAT_FAT_ENTRY_SIZE;
+		seq->offset = getU4LitFrom(&sdat->sdat[fatEntryOffset]);
+		seq->size = getU4LitFrom(&sdat->sdat[fatEntryOffset + 4]);
+		if(!sdatInRange(sdat, seq->offset, seq->size) || (seq->size < 4)
+			|| (memcmp(&sdat->sdat[seq->offset], "SSEQ", 4) != 0))
+		{
+			continue;
+		}
+
+		seq->index = (int) infoIndex;
+		seq->name[0] = '\0';
+		if(infoIndex < numSeqSymbs)
+		{
+			size_t nameOffset = getU4LitFrom(&sdat->sdat[seqSymbOffset + 4 + infoIndex * 4]);
+
+			if(nameOffset)
+			{
+				sdatReadName(sdat, symbOffset + nameOffset, seq->name);
+			}
+		}
+		if(seq->name[0] == '\0')
+		{
+			sprintf(seq->name, "SSEQ_%d", seq->index);
+		}
+		sdat->numSeqs++;
+	}
+	return true;
+}
+
+/* check if size bytes from offset are in sdat */
+bool sdatInRange(const Sdat* sdat, size_t offset, size_t size)
+{
+	return (offset <= sdat->sdatSize) && (size <= sdat->sdatSize - offset);
+}
+
+/* offset of a block from sdat header, 0 if it is missing */
+size_t sdatFindBlock(const Sdat* sdat, size_t headerOffset, const char* magic)
+{
+	size_t blockOffset = getU4LitFrom(&sdat->sdat[headerOffset]);
+
+	if(!blockOffset || !sdatInRange(sdat, blockOffset, SDAT_BLOCK_HEADER_SIZE)
+		|| (memcmp(&sdat->sdat[blockOffset], magic, 4) != 0))
+	{
+		return 0;
+	}
+	return blockOffset;
+}
+
+/* offset of a record (u32 count and u32 offsets) of SYMB or INFO, 0 if it is broken */
+size_t sdatFindRecord(const Sdat* sdat, size_t blockOffset, int recordType)
+{
+	size_t recordOffset;
+	size_t numEntries;
+
+	if(!sdatInRange(sdat, blockOffset + 8 + recordType * 4, 4))
+	{
+		return 0;
+	}
+	recordOffset = blockOffset + getU4LitFrom(&sdat->sdat[blockOffset + 8 + recordType * 4]);
+	if(!sdatInRange(sdat, recordOffset, 4))
+	{
+		return 0;
+	}
+	numEntries = getU4LitFrom(&sdat->sdat[recordOffset]);
+	if((numEntries > sdat->sdatSize / 4) || !sdatInRange(sdat, recordOffset + 4, numEntries * 4))
+	{
+		return 0;
+	}
+	return recordOffset;
+}
+
+/* copy a symbol into name, it must not make a path */
+void sdatReadName(const Sdat* sdat, size_t nameOffset, char* name)
+{
+	size_t nameLength = 0;
+
+	while((nameLength < SDAT_MAX_NAME - 1) && sdatInRange(sdat, nameOffset + nameLength, 1)
+		&& (sdat->sdat[nameOffset + nameLength] != '\0'))
+	{
+		char nameChar = (char) sdat->sdat[nameOffset + nameLength];
+
+		name[nameLength] = (strchr("/\\:*?\"<>|", nameChar) || (nameChar < ' ')) ? '_' : nameChar;
+		nameLength++;
+	}
+	name[nameLength] = '\0';
+}
@@ -0,0 +1,41 @@
+/**
+ * sdat.h: find sseq in nds sound data archive (SDAT)
+ */
+
+#ifndef SDAT_H
+#define SDAT_H
+
+
+#include <stddef.h>
+#include "libsmfc.h"
+#include "sseq2mid.h"
+
+#define SDAT_MAX_NAME           64
+
+/* a sequence in sdat, offsets are of the whole archive */
+typedef struct TagSdatSeq
+{
+  int index;                /* sequence number in INFO block */
+  char name[SDAT_MAX_NAME]; /* symbol in SYMB block, or SSEQ_<index> */
+  size_t offset;
+  size_t size;
+} SdatSeq;
+
+typedef struct TagSdat
+{
+  const byte* sdat;
+  size_t sdatSize;
+  int sdatStorage;          /* SSEQ2MID_STORAGE_* */
+  SdatSeq* seq;
+  int numSeqs;
+} Sdat;
+
+bool sdatIsSdat(const byte* data, size_t dataSize);
+Sdat* sdatCreateBorrowed(const byte* sdat, size_t sdatSize);
+Sdat* sdatCreateFromFile(const char* filename);
+void sdatDelete(Sdat* sdat);
+Sseq2mid* sdatCreateSseq2mid(Sdat* sdat, int seqIndex, bool modifyChOrder);
+bool sdatMatchName(const char* name, const char* pattern);
+
+
+#endif /* !SDAT_H */
@@ -7,54 +7,230 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include "sseq2mid.h"
 #include <stdint.h>
+#ifndef SSEQ2MID_NO_MAIN
+#include "sdat.h"
+#include "sseqflow.h"
+#endif
+#ifndef SSEQ2MID_NO_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #ifndef countof
 #define countof(a)  (sizeof(a) / sizeof(a[0]))
 #endif
 
+#define SSEQ_VARLEN_MAX         4
+#define SSEQ_MAX_OPERAND_SIZE   6   /* If (0xA2) with a note or Random */
+
 #define SSEQ2MID_NAME "sseq2mid"
 #define SSEQ2MID_VER "20070314"
 
 // Currently, when converting sseq->midi->sseq, the final sseq will be larger in file size than the original sseq because the Call event, which compresses SSEQs by reusing identical data, is unsupported.
 
+sseqCom sseqComList[] = {
+	{"Rest", 0x80, VARLENPARAM, NOPARAM, NOPARAM, REST, 0, "Rest"},
+	{"ProgramChange", 0x81, VARLENPARAM, NOPARAM, NOPARAM, PROGRAMCHANGE, 0, "Program Change"},
+	{"OpenTrack", 0x93, U8PARAM, HEXU24PARAM, NOPARAM, NEWTRACK, 0, "Open Track"},
+	{"Jump", 0x94, HEXU24PARAM, NOPARAM, NOPARAM, JUMP, 0, "Jump"},
+	{"Call", 0x95, HEXU24PARAM, NOPARAM, NOPARAM, CALL, 0, "Call"},
+	{"Random", 0xA0, HEXU8PARAM, S16PARAM, S16PARAM, TEXTMARKER, 0, "Random"},
+	{"UseVar", 0xA1, HEXU8PARAM, U8PARAM, NOPARAM, TEXTMARKER, 0, "From Var"},
+	{"If", 0xA2, HEXU8PARAM, NOPARAM, NOPARAM, TEXTMARKER, 0, "If"},
+	{"Pan", 0xC0, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_PANPOT, "Pan"},
+	{"TrackVolume", 0xC1, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_VOLUME, "Track Volume"},
+	{"MasterVolume", 0xC2, U8PARAM, NOPARAM, NOPARAM, MASTERVOLSYSEX, 0, "Master Volume"},
+	{"Transpose", 0xC3, S8PARAM, NOPARAM, NOPARAM, RPNTRANSPOSE, 0, "Transpose"},
+	{"PitchBend", 0xC4, S8PARAM, NOPARAM, NOPARAM, PITCHBEND, 0, "Pitch Bend"},
+	{"PitchBendRange", 0xC5, U8PARAM, NOPARAM, NOPARAM, RPNPITCHBENDRANGE, 0, "Pitch Bend Range"},
+	{"Priority", 0xC6, U8PARAM, NOPARAM, NOPARAM, CC, 14, "Priority"}, // cc14 is undefined
+	{"NoteWait", 0xC7, BOOLPARAM, NOPARAM, NOPARAM, MONOPOLY, 0, "Mono/Poly"},
+	{"Tie", 0xC8, BOOLPARAM, NOPARAM, NOPARAM, TEXTMARKER, 0, "Tie"},
+	{"PortamentoControl", 0xC9, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_PORTAMENTOCTRL, "Portamento Control"},
+	{"ModDepth", 0xCA, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_MODULATION, "Modulation Depth"},
+	{"ModSpeed", 0xCB, U8PARAM, NOPARAM, NOPARAM, CC, 21, "Modulation Speed"}, // same cc as gba_mus_ripper
+	{"ModType", 0xCC, U8PARAM, NOPARAM, NOPARAM, CC, 22, "Modulation Type"},
+	{"ModRange", 0xCD, U8PARAM, NOPARAM, NOPARAM, CC, 3, "Modulation Range"},
+	{"Portamento", 0xCE, BOOLPARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_PORTAMENTO, "Portamento"},
+	{"PortamentoTime", 0xCF, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_PORTAMENTOTIME, "Portamento Time"},
+	{"AttackRate", 0xD0, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_ATTACKTIME, "Attack Rate"},
+	{"DecayRate", 0xD1, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_DECAYTIME, "Decay Rate"},
+	{"SustainRate", 0xD2, U8PARAM, NOPARAM, NOPARAM, CC, 76, "Sustain Rate"}, // generic sound controller
+	{"ReleaseRate", 0xD3, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_RELEASETIME, "Release Rate"},
+	{"LoopStart", 0xD4, U8PARAM, NOPARAM, NOPARAM, LOOPSTART, 0, "Loop Start"},
+	{"Expression", 0xD5, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_EXPRESSION, "Expression"},
+	{"PrintVar", 0xD6, U8PARAM, NOPARAM, NOPARAM, TEXTMARKER, 0, "Print Variable"},
+	{"ModDelay", 0xE0, S16PARAM, NOPARAM, NOPARAM, TEXTMARKER, 0, "Modulation Delay"},
+	{"Tempo", 0xE1, U16PARAM, NOPARAM, NOPARAM, TEMPOSET, 0, "Tempo"},
+	{"SweepPitch", 0xE3, S16PARAM, NOPARAM, NOPARAM, TEXTMARKER, 0, "Sweep Pitch"},
+	{"LoopEnd", 0xFC, NOPARAM, NOPARAM, NOPARAM, LOOPEND, 0, "Loop End"},
+	{"Return", 0xFD, NOPARAM, NOPARAM, NOPARAM, RETURN, 0, "Return"},
+	{"SignifyMultiTrack", 0xFE, U16PARAM, NOPARAM, NOPARAM, 0, 0, "Signify Multi Track"},
+	{"EndOfTrack", 0xFF, NOPARAM, NOPARAM, NOPARAM, 0, 0, "End of Track"},
+};
+
+const size_t sseqComListLen = countof(sseqComList);
+
+// when the -m option is being used: sseq channels 0-8 are placed on midi channels 0-8 then sseq channels 9-14 are placed on midi channels 10-15 then sseq channel 15 is placed on midi channel 0 *on the next midi port*. This is how vgmtrans handles it. Unfortunately, this doesn't solve the issue of the 16th SSEQ track not playing properly, as most midi synthesizer programs seem to ignore the Port event entirely. The only way to play tracks like these correctly is to set the 16th track to a separate synthesizer than all the previous tracks. For example, if you have a midi arranged in your DAW such that all the tracks are underneath the same midi synthesizer VST, you must make another copy of that midi synthesizer VST track, then place the 16th music track under that copy.
+const int sseqMidiChOrder[SSEQ_MAX_TRACK] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 11, 12, 13, 14, 15, 16 };
+// examples of songs that use all 16 SSEQ tracks: Sonic Rush SEQ_4sonic.sseq. Dawn of Sorrow SDL_BGM_BOSS1_.sseq.
+
+/* operators of variable commands (0xB0-0xBD) */
+const char* sseqVarMethodName[] = {
+	"=", "+=", "-=", "*=", "/=", "[Shift]", "[Rand]", "", 
+	"==", ">=", ">", "<=", "<", "!="
+};
+
+/* sseqComList entry and longest parameters of each command byte, built on first use */
+const sseqCom* sseqComTable[256];
+byte sseqMaxOperandSize[256];
+bool sseqComTableBuilt = false;
+#ifndef SSEQ2MID_NO_THREADS
+pthread_once_t sseqComTableOnce = PTHREAD_ONCE_INIT;
+#endif
+
+#ifndef SSEQ2MID_NO_MAIN
+#define SSEQ2MID_SDAT_NAME_SIZE   (SDAT_MAX_NAME + 24)  /* symbol and the sequence number that makes it unique */
+
 bool g_log = false;
 bool g_modifyChOrder = false;
 bool g_noReverb = false;
 int g_loopCount = 1; 
 int g_loopStyle = 0;
 bool g_spacer = false;
-
-void dispatchLogMsg(const char* logMsg);
+bool g_runningStatus = false;
+bool g_parallelTracks = false;
+int g_numJobs = 1;
+const char* g_sdatFilter = NULL;
+bool g_analyze = false;
+
+#ifndef SSEQ2MID_NO_THREADS
+/* an input file of batch conversion, its outputs are kept until its turn */
+typedef struct TagSseq2midFileJob
+{
+  const char* filename;
+  long fileSize;
+  char* text[2];            /* stdout and stderr */
+  size_t textLength[2];
+  size_t maxTextLength[2];
+  bool done;
+} Sseq2midFileJob;
+
+typedef struct TagSseq2midFilePool
+{
+  Sseq2midFileJob** order;  /* larger files first */
+  int numJobs;
+  int nextJob;
+  pthread_mutex_t mutex;
+  pthread_cond_t jobDone;
+} Sseq2midFilePool;
+
+void appendFileJobText(Sseq2midFileJob* fileJob, int stream, const char* text);
+int compareFileJobSize(const void* a, const void* b);
+void* fileJobWorker(void* userData);
+#endif /* !SSEQ2MID_NO_THREADS */
+
+void dispatchLogMsg(const char* logMsg, void* userData);
+void dispatchWarningMsg(const char* warningMsg, void* userData);
 bool dispatchOptionChar(const char optChar);
 bool dispatchOptionStr(const char* optString);
+bool parseOptionCount(const char* optName, const char* optValue, int* count);
 void showUsage(void);
+bool convertFile(const char* filename, void* outputUserData);
+bool convertSseq(Sseq2mid* sseq2mid, const char* sseqName, void* outputUserData);
+bool convertSdat(Sdat* sdat, const char* filename, void* outputUserData);
+void makeSdatOutputName(char* outputName, const SdatSeq* seq, char (*usedName)[SSEQ2MID_SDAT_NAME_SIZE], int numUsedNames);
+bool isSdatOutputNameUsed(const char* outputName, char (*usedName)[SSEQ2MID_SDAT_NAME_SIZE], int numUsedNames);
+bool analyzeSseq(const byte* sseq, size_t sseqSize, const char* sseqName, void* outputUserData);
+void formatFlowTarget(char* text, const SseqFlow* flow, size_t blockIndex);
+void convertFilesInParallel(char* filename[], int numFiles, int numThreads);
 int main(int argc, char* argv[]);
+#endif /* !SSEQ2MID_NO_MAIN */
 
 
 void sseq2midPutLog(Sseq2mid* sseq2mid, const char* logMessage);
+void sseq2midPutWarning(Sseq2mid* sseq2mid, const char* warningMessage);
 void sseq2midPutLogLine(Sseq2mid* sseq2mid, size_t offset, size_t size, 
 	const char* description, const char* comment);
+void sseq2midFormatEventLog(Sseq2mid* sseq2mid, const Sseq2midEventLog* eventLog, char* eventName, char* eventDesc);
+Sseq2mid* sseq2midCreateOnData(const byte* sseq, size_t sseqSize, bool modifyChOrder, int storage);
 int sseq2midSseqChToMidiCh(Sseq2mid* sseq2mid, int sseqChannel);
+bool sseq2midIndexJumpTargets(Sseq2mid* sseq2mid, size_t sseqOffsetBase);
+void sseq2midFreeJumpTargets(Sseq2mid* sseq2mid);
+void sseq2midSetAbsTimeAt(Sseq2mid* sseq2mid, int trackIndex, size_t offset, int absTime);
+int sseq2midGetAbsTimeAt(Sseq2mid* sseq2mid, int trackIndex, size_t offset);
+size_t sseq2midFindJumpTarget(Sseq2mid* sseq2mid, size_t offset);
+
+int getS1From(const byte* data);
+int getS2LitFrom(const byte* data);
+int getS3LitFrom(const byte* data);
+int getS4LitFrom(const byte* data);
+unsigned int getU1From(const byte* data);
+unsigned int getU3LitFrom(const byte* data);
+
+int readParamOfType(int sseqParamType, const byte* sseq, size_t* curOffset);
+size_t sseqGetParamSize(int sseqParamType);
+void formatVarCom(char* outputString, byte statusByte, int varNumber, int val);
+void formatUseVar(char* outputString, byte subStatusByte, int varNumber);
+void formatParamOfType(char* outputText, int sseqParamType, int value);
+
+const sseqCom* sseqFindCom(byte commandByte);
+void sseqBuildComTable(void);
+size_t sseqGetMaxOperandSize(byte commandByte);
+size_t sseqGetMaxInstructionSize(byte commandByte);
+void formatComMarker(char* outputText, const sseqCom* com, const int* param);
+bool sseq2midDecode(Sseq2mid* sseq2mid, size_t sseqOffsetBase);
+void sseq2midFreeInstructions(Sseq2mid* sseq2mid);
+const SseqInstruction* sseq2midGetInstruction(Sseq2mid* sseq2mid, size_t offset, size_t sseqOffsetBase, size_t* hint, SseqInstruction* scratch);
+void sseq2midInitTrackJob(Sseq2midTrackJob* job, Sseq2mid* sseq2mid, int trackIndex, Smf* smf, size_t sseqOffsetBase, Sseq2midLoopPoints* loopPoints);
+void sseq2midConvertTrack(Sseq2midTrackJob* job);
+const Sseq2midCallBlock* sseq2midFindCallBlock(const Sseq2midCallCache* callCache, size_t offset);
+bool sseq2midAddCallBlock(Sseq2midCallCache* callCache, const Sseq2midCallBlock* callBlock);
+size_t sseq2midCountTrackEvents(Smf* smf, int midiCh);
+void sseq2midStartLoopBody(Sseq2midLoopBody* loopBody, size_t offset, Smf* smf, int midiCh, int absTime, int callDepth);
+bool sseq2midCanRepeatLoopBody(const Sseq2midLoopBody* loopBody, size_t offset, int midiCh, int callDepth);
+int sseq2midRepeatLoopBody(Sseq2midTrackJob* job, const Sseq2midLoopBody* loopBody, int absTime, int numRepeats);
+bool sseq2midConvertTracksInParallel(Sseq2mid* sseq2mid, size_t sseqOffsetBase, bool* result);
+void sseq2midInitTracks(Sseq2mid* sseq2mid);
+bool sseq2midQueryTrack(Sseq2mid* sseq2mid, int trackIndex, size_t sseqOffsetBase, Sseq2midInfo* info);
+bool sseq2midAddTempo(Sseq2midInfo* info, int absTime, int bpm);
+
+#ifndef SSEQ2MID_NO_MAIN
+/* dispatch log message, to the file job buffer if any */
+void dispatchLogMsg(const char* logMsg, void* userData)
+{
+#ifndef SSEQ2MID_NO_THREADS
+	if(userData)
+	{
+		appendFileJobText((Sseq2midFileJob*) userData, 0, logMsg);
+		return;
+	}
+#endif
+	fputs(logMsg, stdout);	 /* output to stdout */
+}
 
-int getS1From(byte* data);
-int getS2LitFrom(byte* data);
-int getS3LitFrom(byte* data);
-int getS4LitFrom(byte* data);
-unsigned int getU1From(byte* data);
-unsigned int getU2LitFrom(byte* data);
-unsigned int getU3LitFrom(byte* data);
-unsigned int getU4LitFrom(byte* data);
-
-void readVarCom(byte* sseq, size_t* curOffset, char* outputString, byte statusByte, char* eventName, char* eventDesc);
-void readUseVar(byte* sseq, size_t* curOffset, char* outputString, char* eventName, char* eventDesc);
-void readParamOfType(char* outputText, int sseqParamType, byte* sseq, size_t* curOffset, size_t* sseqOffsetBase, size_t* sseqSize);
-
-/* dispatch log message */
-void dispatchLogMsg(const char* logMsg)
+/* dispatch warning and error message, to the file job buffer if any */
+void dispatchWarningMsg(const char* warningMsg, void* userData)
 {
-	printf(logMsg);	 /* output to stdout */
+#ifndef SSEQ2MID_NO_THREADS
+	if(userData)
+	{
+		appendFileJobText((Sseq2midFileJob*) userData, 1, warningMsg);
+		return;
+	}
+#endif
+	fputs(warningMsg, stderr);	 /* output to stderr */
 }
 
 /* dispatch option character */
@@ -97,6 +273,14 @@ bool dispatchOptionChar(const char optChar)
 	case 'm':
 		g_modifyChOrder = true;
 		break;
+
+	case 'p':
+		g_parallelTracks = true;
+		break;
+
+	case 'r':
+		g_runningStatus = true;
+		break;
 	
 	case 's':
 		g_spacer = true;
@@ -127,6 +311,14 @@ bool dispatchOptionStr(const char* optString)
 	{
 		g_noReverb = true;
 	}
+	else if(strcmp(optString, "running-status") == 0)
+	{
+		g_runningStatus = true;
+	}
+	else if(strcmp(optString, "parallel-tracks") == 0)
+	{
+		g_parallelTracks = true;
+	}
 	else if(strcmp(optString, "1loop") == 0)
 	{
 		g_loopCount = 1;
@@ -155,6 +347,10 @@ bool dispatchOptionStr(const char* optString)
 	{
 			g_spacer = true;
 	}
+	else if(strcmp(optString, "analyze") == 0)
+	{
+		g_analyze = true;
+	}
 	else
 	{
 		return false;
@@ -162,6 +358,31 @@ bool dispatchOptionStr(const char* optString)
 	return true;
 }
 
+/* read the number N of an option, which must be 1 or more */
+bool parseOptionCount(const char* optName, const char* optValue, int* count)
+{
+	char* endPtr = NULL;
+	long value = 0;
+
+	if(optValue)
+	{
+		errno = 0;
+		value = strtol(optValue, &endPtr, 10);
+	}
+	if(!optValue || (endPtr == optValue) || (*endPtr != '\0') || (errno == ERANGE) 
+		|| (value < 1) || (value > INT_MAX))
+	{
+		char errorMsg[256];
+
+		snprintf(errorMsg, sizeof(errorMsg), "error: %s needs a number of 1 or more, not \"%.64s\"\n", 
+			optName, optValue ? optValue : "");
+		dispatchWarningMsg(errorMsg, NULL);
+		return false;
+	}
+	*count = (int) value;
+	return true;
+}
+
 /* show sseq2mid usage */
 void showUsage(void)
 {
@@ -170,16 +391,23 @@ void showUsage(void)
 		"-0", "--noreverb", "set 0 to reverb send", 
 		"-1", "--1loop", "convert to 1 loop (no loop)", 
 		"-2", "--2loop", "convert to 2 loop", 
+		"", "--loops N", "convert to N loops",
 		"-d", "--loopstyle1", "Duke nukem style loop points (Event 0x74/0x75)",
 		"-7", "--loopstyle2", "FF7 PC style loop points (Meta text \"loop(start/end)\"",
 		"-c", "--loopstyle3", "Complex loops: insert multiple jump events instead of simplifying to loop points.",
 		"-l", "--log", "put conversion log", 
 		"-m", "--modify-ch", "modify midi channel to avoid rhythm channel",
+		"-p", "--parallel-tracks", "convert tracks on multiple threads (ignored with -j, -l, -d, -7)",
+		"-j N", "--jobs N", "convert N files at once",
+		"-f PAT", "--filter PAT", "convert only sequences of sdat named like PAT (e.g. BGM_*)",
+		"", "--analyze", "report tracks, blocks, loops and unreached bytes instead of converting",
+		"-r", "--running-status", "use running status to make output smaller",
 		"-s", "--spacer", "(EXPERIMENTAL) insert a short rest in between simultaneous events"
 	};
 	int optIndex;
 
 	puts("usage	: sseq2mid (options) [input-files]");
+	puts("input files are sseq, or sdat whose sequences are converted into <SYMBOL>.sseq.mid");
 	puts("options:");
 	for(optIndex = 0; optIndex < countof(options); optIndex += 3)
 	{
@@ -189,1375 +417,3361 @@ void showUsage(void)
 	puts(SSEQ2MID_NAME" ["SSEQ2MID_VER"] by loveemu");
 }
 
-/* sseq2mid application main */
-int main(int argc, char* argv[])
+/* convert an input file into <filename>.mid, or sdat into a file per sequence beside it,
+   outputUserData is passed to dispatch functions */
+bool convertFile(const char* filename, void* outputUserData)
 {
-	int argi = 1;
-	int argci;
+	size_t dataSize;
+	int storage;
+	const byte* data = sseq2midLoadFile(filename, &dataSize, &storage);
+	bool convResult = false;
 
-	if(argc == 1) /* no arguments */
+	if(!data)
 	{
-		showUsage();
+		dispatchWarningMsg("error: I/O initialize error\n", outputUserData);
+		return false;
 	}
-	else
+
+	if(sdatIsSdat(data, dataSize))
 	{
-		/* options */
-		while((argi < argc) && (argv[argi][0] == '-'))
+		Sdat* sdat = sdatCreateBorrowed(data, dataSize);
+
+		if(sdat)
 		{
-			if(argv[argi][1] == '-') /* --string */
-			{
-				dispatchOptionStr(&argv[argi][2]);
-			}
-			else /* -letters (alphanumeric only) */
-			{
-				argci = 1;
-				while(argv[argi][argci] != '\0')
-				{
-					dispatchOptionChar(argv[argi][argci]);
-					argci++;
-				}
-			}
-			argi++;
+			convResult = convertSdat(sdat, filename, outputUserData);
+			sdatDelete(sdat);
 		}
-
-		/* input files */
-		for(; argi < argc; argi++)
+		else
 		{
-			Sseq2mid* sseq2mid = sseq2midCreateFromFile(argv[argi], g_modifyChOrder);
-			bool convResult;
-
-			if(sseq2mid)
-			{
-				char* midFilename;
+			dispatchWarningMsg(filename, outputUserData);
+			dispatchWarningMsg(":\n", outputUserData);
+			dispatchWarningMsg("error: broken sdat\n", outputUserData);
+		}
+	}
+	else
+	{
+		convResult = convertSseq(sseq2midCreateBorrowed(data, dataSize, g_modifyChOrder), filename, outputUserData);
+	}
+	sseq2midReleaseData(data, dataSize, storage);
+	return convResult;
+}
 
-				midFilename = (char*) malloc((strlen(argv[argi]) + 5) * sizeof(char));
-				if(midFilename)
-				{
-					sprintf(midFilename, "%s.mid", argv[argi]);
+/* convert sseq into <sseqName>.mid (or analyze it), sseq2mid is deleted */
+bool convertSseq(Sseq2mid* sseq2mid, const char* sseqName, void* outputUserData)
+{
+	bool convResult = false;
 
-					sseq2midSetLoopCount(sseq2mid, g_loopCount);
-					sseq2midNoReverb(sseq2mid, g_noReverb);
-					if(g_log)
-					{
-						sseq2midSetLogProc(sseq2mid, dispatchLogMsg);
-					}
-					sseq2midPutLog(sseq2mid, argv[argi]);
-					sseq2midPutLog(sseq2mid, ":\n");
-					fprintf(stderr, "%s:\n", argv[argi]);
-					convResult = sseq2midConvert(sseq2mid);
-					if(!convResult)
-					{
-						fprintf(stderr, "error: conversion failed\n", argv[argi]);
-					}
-					sseq2midWriteMidiFile(sseq2mid, midFilename);
-					sseq2midDelete(sseq2mid);
+	if(sseq2mid && g_analyze)
+	{
+		convResult = analyzeSseq(sseq2mid->sseq, sseq2mid->sseqSize, sseqName, outputUserData);
+		sseq2midDelete(sseq2mid);
+	}
+	else if(sseq2mid)
+	{
+		char* midFilename;
 
-					free(midFilename);
-				}
-				else
-				{
-					fprintf(stderr, "error: memory allocation failed\n", argv[argi]);
-				}
+		midFilename = (char*) malloc((strlen(sseqName) + 5) * sizeof(char));
+		if(midFilename)
+		{
+			sprintf(midFilename, "%s.mid", sseqName);
+
+			sseq2midSetLoopCount(sseq2mid, g_loopCount);
+			sseq2midNoReverb(sseq2mid, g_noReverb);
+			sseq2midParallelTracks(sseq2mid, g_parallelTracks);
+			sseq2midUseRunningStatus(sseq2mid, g_runningStatus);
+			sseq2midSetLoopStyle(sseq2mid, g_loopStyle);
+			sseq2midUseSpacer(sseq2mid, g_spacer);
+			sseq2midSetWarningProc(sseq2mid, dispatchWarningMsg, outputUserData);
+			if(g_log)
+			{
+				sseq2midSetLogProc(sseq2mid, dispatchLogMsg, outputUserData);
 			}
-			else
+			sseq2midPutLog(sseq2mid, sseqName);
+			sseq2midPutLog(sseq2mid, ":\n");
+			dispatchWarningMsg(sseqName, outputUserData);
+			dispatchWarningMsg(":\n", outputUserData);
+			convResult = sseq2midConvert(sseq2mid);
+			if(!convResult)
 			{
-				fprintf(stderr, "error: I/O initialize error\n", argv[argi]);
+				dispatchWarningMsg("error: conversion failed\n", outputUserData);
 			}
+			sseq2midWriteMidiFile(sseq2mid, midFilename);
+
+			free(midFilename);
 		}
+		else
+		{
+			dispatchWarningMsg("error: memory allocation failed\n", outputUserData);
+		}
+		sseq2midDelete(sseq2mid);
 	}
-	return 0;
-}
-
-
-/* call the fuction to put log message */
-void sseq2midPutLog(Sseq2mid* sseq2mid, const char* logMessage)
-{
-	if(sseq2mid && sseq2mid->logProc)
+	else
 	{
-		sseq2mid->logProc(logMessage);
+		dispatchWarningMsg("error: I/O initialize error\n", outputUserData);
 	}
+	return convResult;
 }
 
-#define SSEQ2MID_MAX_DUMP	 5
-
-/* put log message in prescribed form */
-void sseq2midPutLogLine(Sseq2mid* sseq2mid, size_t offset, size_t size, 
-	const char* description, const char* comment)
+/* convert sequences of sdat that match the filter, into <SYMBOL>.sseq.mid in the directory of sdat
+   (or <SYMBOL>_<number>.sseq.mid, when an earlier sequence took the name) */
+bool convertSdat(Sdat* sdat, const char* filename, void* outputUserData)
 {
-	if(sseq2mid)
+	const char* lastSlash = strrchr(filename, '/');
+	const char* lastBackslash = strrchr(filename, '\\');
+	int dirLength = 0;
+	char* sseqName;
+	char (*outputName)[SSEQ2MID_SDAT_NAME_SIZE];
+	int numOutputNames = 0;
+	bool convResult = true;
+	int seqIndex;
+
+	if(lastBackslash > lastSlash)
 	{
-		char logMsg[96];
-		char hexDump[24];
-		char hexDumpPart[8];
-		size_t sizeToTransfer;
-		size_t transferedSize;
-		byte* sseq = sseq2mid->sseq;
-		size_t sseqSize = sseq2mid->sseqSize;
-
-		sizeToTransfer = (offset + size <= sseqSize) ? size : sseqSize - offset;
-		sizeToTransfer = (sizeToTransfer < SSEQ2MID_MAX_DUMP) ? sizeToTransfer : SSEQ2MID_MAX_DUMP;
+		lastSlash = lastBackslash;
+	}
+	if(lastSlash)
+	{
+		dirLength = (int) (lastSlash - filename) + 1;
+	}
 
-		strcpy(hexDump, "");
-		for(transferedSize = 0; transferedSize < sizeToTransfer; transferedSize++)
+	sseqName = (char*) malloc((dirLength + SSEQ2MID_SDAT_NAME_SIZE + 6) * sizeof(char));
+	outputName = (char (*)[SSEQ2MID_SDAT_NAME_SIZE]) malloc(sizeof(*outputName) * (sdat->numSeqs ? sdat->numSeqs : 1));
+	if(!sseqName || !outputName)
+	{
+		dispatchWarningMsg("error: memory allocation failed\n", outputUserData);
+		free(outputName);
+		free(sseqName);
+		return false;
+	}
+	for(seqIndex = 0; seqIndex < sdat->numSeqs; seqIndex++)
+	{
+		if(g_sdatFilter && !sdatMatchName(sdat->seq[seqIndex].name, g_sdatFilter))
 		{
-			if(transferedSize != 0)
-			{
-				strcat(hexDump, " ");
-			}
-			sprintf(hexDumpPart, "%02X", sseq[offset + transferedSize]);
-			strcat(hexDump, hexDumpPart);
+			continue;
+		}
+		makeSdatOutputName(outputName[numOutputNames], &sdat->seq[seqIndex], outputName, numOutputNames);
+		sprintf(sseqName, "%.*s%s.sseq", dirLength, filename, outputName[numOutputNames]);
+		numOutputNames++;
+		if(!convertSseq(sdatCreateSseq2mid(sdat, seqIndex, g_modifyChOrder), sseqName, outputUserData))
+		{
+			convResult = false;
 		}
-
-		sprintf(logMsg, "%08X: %-14s | %-20s | %s\n", offset, hexDump, 
-			description ? description : "", comment ? comment : "");
-		sseq2midPutLog(sseq2mid, logMsg);
 	}
-}
+	if(g_sdatFilter && (numOutputNames == 0))
+	{
+		char warningMsg[256];
 
-/* filter: sseq channel number to midi track number */
-int sseq2midSseqChToMidiCh(Sseq2mid* sseq2mid, int sseqChannel)
-{
-	return ((sseqChannel >= 0) && (sseqChannel <= SSEQ_MAX_TRACK)) ? sseq2mid->chOrder[sseqChannel] : sseqChannel;
+		dispatchWarningMsg(filename, outputUserData);
+		dispatchWarningMsg(":\n", outputUserData);
+		snprintf(warningMsg, sizeof(warningMsg), "warning: no sequence matches \"%.64s\"\n", g_sdatFilter);
+		dispatchWarningMsg(warningMsg, outputUserData);
+	}
+	free(outputName);
+	free(sseqName);
+	return convResult;
 }
 
-/* create sseq2mid object */
-Sseq2mid* sseq2midCreate(const byte* sseq, size_t sseqSize, bool modifyChOrder)
+/* output name of a sequence of sdat: its symbol, unless a name used already would be overwritten */
+void makeSdatOutputName(char* outputName, const SdatSeq* seq, char (*usedName)[SSEQ2MID_SDAT_NAME_SIZE], int numUsedNames)
 {
-	Sseq2mid* newSseq2mid = (Sseq2mid*) calloc(1, sizeof(Sseq2mid));
+	int retryCount = 0;
 
-	if(newSseq2mid)
+	snprintf(outputName, SSEQ2MID_SDAT_NAME_SIZE, "%s", seq->name);
+	while(isSdatOutputNameUsed(outputName, usedName, numUsedNames))
 	{
-		newSseq2mid->sseq = (byte*) malloc(sseqSize);
-		if(newSseq2mid->sseq)
+		/* a real symbol can look like one made here, so try until a free one is found */
+		retryCount++;
+		if(retryCount == 1)
 		{
-			newSseq2mid->smf = smfCreate();
-			if(newSseq2mid->smf)
-			{
-				memcpy(newSseq2mid->sseq, sseq, sseqSize);
-				newSseq2mid->sseqSize = sseqSize;
-
-				smfSetTimebase(newSseq2mid->smf, 48);
-				newSseq2mid->loopCount = 1;
-				newSseq2mid->noReverb = false;
-				newSseq2mid->modifyChOrder = modifyChOrder;
-			}
-			else
-			{
-				free(newSseq2mid->sseq);
-				free(newSseq2mid);
-				newSseq2mid = NULL;
-			}
+			snprintf(outputName, SSEQ2MID_SDAT_NAME_SIZE, "%s_%d", seq->name, seq->index);
 		}
 		else
 		{
-			free(newSseq2mid);
-			newSseq2mid = NULL;
+			snprintf(outputName, SSEQ2MID_SDAT_NAME_SIZE, "%s_%d_%d", seq->name, seq->index, retryCount);
 		}
 	}
-	return newSseq2mid;
 }
 
-/* create sseq2mid object from file */
-Sseq2mid* sseq2midCreateFromFile(const char* filename, bool modifyChOrder)
+/* names are compared ignoring case, as file systems often do */
+bool isSdatOutputNameUsed(const char* outputName, char (*usedName)[SSEQ2MID_SDAT_NAME_SIZE], int numUsedNames)
 {
-	Sseq2mid* newSseq2mid = NULL;
-	FILE* sseqFile = fopen(filename, "rb");
+	int nameIndex;
 
-	if(sseqFile)
+	for(nameIndex = 0; nameIndex < numUsedNames; nameIndex++)
 	{
-		size_t sseqSize;
-		byte* sseq;
-
-		fseek(sseqFile, 0, SEEK_END);
-		sseqSize = (size_t) ftell(sseqFile);
-		rewind(sseqFile);
+		const char* a = outputName;
+		const char* b = usedName[nameIndex];
 
-		sseq = (byte*) malloc(sseqSize);
-		if(sseq)
+		while((*a != '\0') && (tolower((unsigned char) *a) == tolower((unsigned char) *b)))
 		{
-			fread(sseq, sseqSize, 1, sseqFile);
-			newSseq2mid = sseq2midCreate(sseq, sseqSize, modifyChOrder);
-			free(sseq);
+			a++;
+			b++;
+		}
+		if(tolower((unsigned char) *a) == tolower((unsigned char) *b))
+		{
+			return true;
 		}
-
-		fclose(sseqFile);
 	}
-	return newSseq2mid;
+	return false;
 }
 
-/* delete sseq2mid object */
-void sseq2midDelete(Sseq2mid* sseq2mid)
+/* report control flow of sseq: tracks, blocks with their edges, loops and unreached bytes */
+bool analyzeSseq(const byte* sseq, size_t sseqSize, const char* sseqName, void* outputUserData)
 {
-	if(sseq2mid)
+	SseqFlow* flow = sseqFlowCreate(sseq, sseqSize);
+	char line[160];
+	char nextText[16];
+	char branchText[16];
+	size_t blockIndex;
+	size_t loopIndex;
+	size_t offset;
+	int trackIndex;
+
+	dispatchLogMsg(sseqName, outputUserData);
+	dispatchLogMsg(":\n", outputUserData);
+	if(!flow)
 	{
-		smfDelete(sseq2mid->smf);
-		free(sseq2mid->sseq);
-		free(sseq2mid);
+		dispatchWarningMsg(sseqName, outputUserData);
+		dispatchWarningMsg(":\n", outputUserData);
+		dispatchWarningMsg("error: analysis failed\n", outputUserData);
+		return false;
 	}
-}
-
-/* copy sseq2mid object */
-Sseq2mid* sseq2midCopy(Sseq2mid* sseq2mid)
-{
-	Sseq2mid* newSseq2mid = NULL;
 
-	if(sseq2mid)
+	for(trackIndex = 0; trackIndex < SSEQ_MAX_TRACK; trackIndex++)
 	{
-		newSseq2mid = sseq2midCreate(sseq2mid->sseq, sseq2mid->sseqSize, sseq2mid->modifyChOrder);
-		if(newSseq2mid)
+		const SseqFlowTrack* track = &flow->track[trackIndex];
+
+		if(track->opened)
 		{
-			smfDelete(newSseq2mid->smf);
-			newSseq2mid->smf = smfCopy(sseq2mid->smf);
-			if(newSseq2mid->smf)
-			{
-				sseq2midSetLogProc(newSseq2mid, sseq2mid->logProc);
-				sseq2midSetLoopCount(newSseq2mid, sseq2mid->loopCount);
-			}
-			else
+			int lineLength = snprintf(line, sizeof(line), "Track %02d: %08X", trackIndex + 1, (unsigned int) track->offset);
+
+			if(track->openedAt != SSEQ_INVALID_OFFSET)
 			{
-				sseq2midDelete(newSseq2mid);
-				newSseq2mid = NULL;
+				lineLength += snprintf(&line[lineLength], sizeof(line) - lineLength, " (opened at %08X)", (unsigned int) track->openedAt);
 			}
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "%s%s\n", 
+				track->reachesEnd ? ", ends" : "", track->endless ? ", loops endlessly" : "");
+			dispatchLogMsg(line, outputUserData);
 		}
 	}
-	return newSseq2mid;
-}
+	if(flow->allocatedTracks)
+	{
+		snprintf(line, sizeof(line), "Allocated Tracks: %04X\n", flow->allocatedTracks);
+		dispatchLogMsg(line, outputUserData);
+	}
 
-#define SSEQ_MIN_SIZE	 0x1d
+	dispatchLogMsg("Blocks:\n", outputUserData);
+	for(blockIndex = 0; blockIndex < flow->numBlocks; blockIndex++)
+	{
+		const SseqFlowBlock* block = &flow->block[blockIndex];
+		const SseqInstruction* lastInstruction = &flow->instruction[block->lastInstruction];
+		int lineLength = snprintf(line, sizeof(line), "%08X-%08X tracks:%04X  ", 
+			(unsigned int) block->offset, (unsigned int) block->endOffset - 1, block->trackMask);
+
+		formatFlowTarget(nextText, flow, block->next);
+		formatFlowTarget(branchText, flow, block->branch);
+		switch(lastInstruction->command)
+		{
+		case 0x93:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "Open Track %02d %s%s, next %s\n", lastInstruction->param[0] + 1, branchText, 
+				(lastInstruction->param[0] < SSEQ_MAX_TRACK) ? "" : " (out of range)", nextText);
+			break;
 
-/* sseq2mid conversion main, enjoy my dirty code :P */
-bool sseq2midConvert(Sseq2mid* sseq2mid)
-{
-	bool result = false;
-	char strForLog[64];
-	int loopStartCount;
-	size_t loopStartOffset;
-	bool loopPointUsed = false;
-	bool loopStartPointUsed = false;
-	bool loopEndPointUsed = false;
+		case 0x94:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "Jump %s\n", branchText);
+			break;
 
-	if(sseq2mid)
-	{
-		byte* sseq = sseq2mid->sseq;
-		size_t sseqSize = sseq2mid->sseqSize;
-		Smf* smf = sseq2mid->smf;
+		case 0x95:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "Call %s, next %s\n", branchText, nextText);
+			break;
 
-		if((sseqSize >= SSEQ_MIN_SIZE) && 
-				(sseq[0x00] == 'S') && (sseq[0x01] == 'S') && (sseq[0x02] == 'E') && (sseq[0x03] == 'Q') && 
-				(sseq[0x10] == 'D') && (sseq[0x11] == 'A') && (sseq[0x12] == 'T') && (sseq[0x13] == 'A'))
-		{
-			int trackIndex;
-			int midiCh;
-			size_t sseqOffsetBase;
-			// when the -m option is being used: sseq channels 0-8 are placed on midi channels 0-8 then sseq channels 9-14 are placed on midi channels 10-15 then sseq channel 15 is placed on midi channel 0 *on the next midi port*. This is how vgmtrans handles it. Unfortunately, this doesn't solve the issue of the 16th SSEQ track not playing properly, as most midi synthesizer programs seem to ignore the Port event entirely. The only way to play tracks like these correctly is to set the 16th track to a separate synthesizer than all the previous tracks. For example, if you have a midi arranged in your DAW such that all the tracks are underneath the same midi synthesizer VST, you must make another copy of that midi synthesizer VST track, then place the 16th music track under that copy.
-			int midiChOrder[SSEQ_MAX_TRACK] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 11, 12, 13, 14, 15, 16 };
-			// examples of songs that use all 16 SSEQ tracks: Sonic Rush SEQ_4sonic.sseq. Dawn of Sorrow SDL_BGM_BOSS1_.sseq.
-			
-			/* put SSEQ header info */
-			sseq2midPutLogLine(sseq2mid, 0x00, 4, "Signature", "SSEQ");
-			sseq2midPutLogLine(sseq2mid, 0x04, 2, "", "Unknown");
-			sseq2midPutLogLine(sseq2mid, 0x06, 2, "", "Unknown");
-			sprintf(strForLog, "%u", getU4LitFrom(&sseq[0x08]));
-			sseq2midPutLogLine(sseq2mid, 0x08, 4, "SSEQ file size", strForLog);
-			sseq2midPutLogLine(sseq2mid, 0x0c, 2, "", "Unknown");
-			sseq2midPutLogLine(sseq2mid, 0x0e, 2, "", "Unknown");
-			sseq2midPutLog(sseq2mid, "\n");
-
-			/* put DATA chunk header */
-			sseq2midPutLogLine(sseq2mid, 0x10, 4, "Signature", "DATA");
-			sprintf(strForLog, "%u", getU4LitFrom(&sseq[0x14]));
-			sseq2midPutLogLine(sseq2mid, 0x14, 4, "DATA chunk size", strForLog);
-			sseqOffsetBase = (size_t) getU4LitFrom(&sseq[0x18]);
-			sprintf(strForLog, "%08X", sseqOffsetBase);
-			sseq2midPutLogLine(sseq2mid, 0x18, 4, "Offset Base", strForLog);
-			sseq2midPutLog(sseq2mid, "\n");
+		case 0xd4:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "Loop Start %d, next %s\n", lastInstruction->param[0], nextText);
+			break;
 
-			/* initialize channel order */
-			for(midiCh = 0; midiCh < SSEQ_MAX_TRACK; midiCh++)
+		case 0xfc:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "Loop End %s, next %s\n", branchText, nextText);
+			break;
+
+		case 0xfd:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "Return\n");
+			break;
+
+		case 0xff:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "End of Track\n");
+			break;
+
+		default:
+			if((lastInstruction->command == 0xa2) && (lastInstruction->subCommand == 0x94))
 			{
-				sseq2mid->chOrder[midiCh] = sseq2mid->modifyChOrder ? midiChOrder[midiCh] : midiCh;
+				snprintf(&line[lineLength], sizeof(line) - lineLength, "If Jump %s, next %s\n", branchText, nextText);
 			}
-
-			/* initialize track settings */
-			sseq2mid->track[0].loopCount = sseq2mid->loopCount;
-			sseq2mid->track[0].absTime = 0; 
-			sseq2mid->track[0].noteWait = false;
-			sseq2mid->track[0].offsetToTop = 0x1c;
-			sseq2mid->track[0].offsetToReturn = SSEQ_INVALID_OFFSET;
-			sseq2mid->track[0].curOffset = sseq2mid->track[0].offsetToTop;
-			for(trackIndex = 1; trackIndex < SSEQ_MAX_TRACK; trackIndex++)
+			else if(!sseqIsKnownCommand(lastInstruction->command))
 			{
-				sseq2mid->track[trackIndex].loopCount = 0;	/* inactive */
-				sseq2mid->track[trackIndex].noteWait = false;
+				snprintf(&line[lineLength], sizeof(line) - lineLength, "Unknown Event %02X\n", lastInstruction->command);
 			}
-
-			/* initialize midi */
-#if 0
-			smfInsertGM1SystemOn(smf, 0, 0, 0);
-#endif
-
-			/* convert each track */
-			result = true;
-			for(trackIndex = 0; trackIndex < SSEQ_MAX_TRACK; trackIndex++)
+			else
 			{
-				int loopCount = sseq2mid->track[trackIndex].loopCount;
-				
-				int stackedEventTimeSpacer = 0; // used to space out midi events that, in the original sseq, happen at the same time (but in a specific order). The spacer ensures that the order of events is the same as in the sseq.
-				
-				uint8_t jumpIndex=0;
-				
-				byte prevStatusByte=0x00;
-
-				if(loopCount > 0)
-				{
-					do
-					{
-						int absTime = sseq2mid->track[trackIndex].absTime; // absTime does not persist through each loop, but sseq2mid->track[trackIndex].absTime does. All assignments to absTime go to sseq2mid->track[trackIndex].absTime
-						size_t curOffset = sseq2mid->track[trackIndex].curOffset;
-						size_t eventOffset = curOffset;
-						char eventName[64];
-						char eventDesc[64];
-						bool eventException;
-						size_t eventExceptionOffset = curOffset;
-						size_t offsetToJump = SSEQ_INVALID_OFFSET;
-
-						midiCh = sseq2midSseqChToMidiCh(sseq2mid, trackIndex);
-						sprintf(eventName, "Access Violation");
-						sprintf(eventDesc, "End of File at %08X", sseqSize);
-						eventException = true;
-
-						if(curOffset < sseqSize)
-						{
-							byte statusByte;
-					
-							sseq2mid->track[trackIndex].offsetToAbsTime[curOffset] = absTime;
-
-							statusByte = getU1From(&sseq[curOffset]);
-							curOffset++;
+				snprintf(&line[lineLength], sizeof(line) - lineLength, "next %s\n", nextText);
+			}
+			break;
+		}
+		dispatchLogMsg(line, outputUserData);
+	}
 
-							sprintf(eventName, "Unknown Event %02X", statusByte);
-							sprintf(eventDesc, "");
-							eventException = false;
+	if(flow->numLoops > 0)
+	{
+		dispatchLogMsg("Loops:\n", outputUserData);
+	}
+	for(loopIndex = 0; loopIndex < flow->numLoops; loopIndex++)
+	{
+		const SseqFlowLoop* loop = &flow->loop[loopIndex];
+		int lineLength = snprintf(line, sizeof(line), "Track %02d: %08X-%08X ", 
+			loop->track + 1, (unsigned int) loop->startOffset, (unsigned int) loop->endOffset);
 
-							if(statusByte < 0x80)
-							{
-								if (g_spacer) {
-									if (prevStatusByte < 0x80) stackedEventTimeSpacer--;
-								}
-								
-								int velocity;
-								int duration;
-								const char* noteName[] = {
-									"C ", "C#", "D ", "D#", "E ", "F ", 
-									"F#", "G ", "G#", "A ", "A#", "B "
-								};
-
-								velocity = getU1From(&sseq[curOffset]);
-								curOffset++;
-								duration = smfReadVarLength(&sseq[curOffset], sseqSize - curOffset);
-								curOffset += smfGetVarLengthSize(duration);
-
-								smfInsertNote(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, statusByte, velocity, duration);
-								if(sseq2mid->track[trackIndex].noteWait)
-								{
-									absTime += duration;
-									stackedEventTimeSpacer=0;
-								}
+		switch(loop->type)
+		{
+		case SSEQ_FLOW_LOOP_JUMP:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "Jump back, endless\n");
+			break;
 
-								sprintf(eventName, "Note with Duration");
-								sprintf(eventDesc, "%s %d [%d]	vel:%-3d dur:%-3d", noteName[statusByte % 12], 
-									(statusByte / 12) - 1, statusByte, velocity, duration);
-							}
-							else
-							{
-								switch(statusByte) // Match sseq commands with equivalent midi commands, and if no equivalent midi commands exist, match them with undefined midi CCs. This program is compatible with my fork of midi2sseq, and it is possible to convert back and forth between sseq and midi (mostly) losslessly.
-								{
-								case 0x80:
-								{
-									int tick;
+		case SSEQ_FLOW_LOOP_IF:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "If Jump back\n");
+			break;
 
-									tick = smfReadVarLength(&sseq[curOffset], sseqSize - curOffset);
-									curOffset += smfGetVarLengthSize(tick);
+		case SSEQ_FLOW_LOOP_COUNTED:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "Loop Start %d\n", loop->count);
+			break;
 
-									absTime += tick;
-									
-									stackedEventTimeSpacer=0;
+		case SSEQ_FLOW_LOOP_ENDLESS:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "Loop Start 0, endless\n");
+			break;
 
-									sprintf(eventName, "Rest");
-									sprintf(eventDesc, "%d", tick);
-									break;
-								}
+		case SSEQ_FLOW_LOOP_CALL:
+			snprintf(&line[lineLength], sizeof(line) - lineLength, "Call back\n");
+			break;
+		}
+		dispatchLogMsg(line, outputUserData);
+	}
+
+	/* bytes of DATA that no command covers */
+	offset = SSEQ_FLOW_TRACK0_OFFSET;
+	while(offset < flow->sseqSize)
+	{
+		size_t unreachedOffset = offset;
+
+		while((offset < flow->sseqSize) && !sseqFlowIsReached(flow, offset))
+		{
+			offset++;
+		}
+		if(offset > unreachedOffset)
+		{
+			snprintf(line, sizeof(line), "Unreached: %08X-%08X (%u bytes)\n", 
+				(unsigned int) unreachedOffset, (unsigned int) offset - 1, (unsigned int) (offset - unreachedOffset));
+			dispatchLogMsg(line, outputUserData);
+		}
+		while((offset < flow->sseqSize) && sseqFlowIsReached(flow, offset))
+		{
+			offset++;
+		}
+	}
+	dispatchLogMsg("\n", outputUserData);
+
+	sseqFlowDelete(flow);
+	return true;
+}
+
+/* format offset of a block, or dashes if there is none */
+void formatFlowTarget(char* text, const SseqFlow* flow, size_t blockIndex)
+{
+	if(blockIndex == SSEQ_FLOW_NO_BLOCK)
+	{
+		strcpy(text, "--------");
+	}
+	else
+	{
+		sprintf(text, "%08X", (unsigned int) flow->block[blockIndex].offset);
+	}
+}
+
+#ifndef SSEQ2MID_NO_THREADS
+/* append a message to the buffered output of a file */
+void appendFileJobText(Sseq2midFileJob* fileJob, int stream, const char* text)
+{
+	size_t textLength = strlen(text);
+	size_t newLength = fileJob->textLength[stream] + textLength;
+
+	if(newLength + 1 > fileJob->maxTextLength[stream])
+	{
+		size_t newMaxLength = fileJob->maxTextLength[stream] ? fileJob->maxTextLength[stream] : 256;
+		char* newText;
+
+		while(newLength + 1 > newMaxLength)
+		{
+			newMaxLength *= 2;
+		}
+		newText = (char*) realloc(fileJob->text[stream], newMaxLength);
+		if(!newText)
+		{
+			return;
+		}
+		fileJob->text[stream] = newText;
+		fileJob->maxTextLength[stream] = newMaxLength;
+	}
+	memcpy(&fileJob->text[stream][fileJob->textLength[stream]], text, textLength + 1);
+	fileJob->textLength[stream] = newLength;
+}
+
+/* order of file jobs, larger files first */
+int compareFileJobSize(const void* a, const void* b)
+{
+	const Sseq2midFileJob* fileJobA = *(const Sseq2midFileJob**) a;
+	const Sseq2midFileJob* fileJobB = *(const Sseq2midFileJob**) b;
+
+	if(fileJobA->fileSize != fileJobB->fileSize)
+	{
+		return (fileJobA->fileSize > fileJobB->fileSize) ? -1 : 1;
+	}
+	return (fileJobA < fileJobB) ? -1 : (fileJobA > fileJobB);
+}
+
+/* worker of batch conversion, takes files until none is left */
+void* fileJobWorker(void* userData)
+{
+	Sseq2midFilePool* pool = (Sseq2midFilePool*) userData;
+
+	for(;;)
+	{
+		Sseq2midFileJob* fileJob = NULL;
+
+		pthread_mutex_lock(&pool->mutex);
+		if(pool->nextJob < pool->numJobs)
+		{
+			fileJob = pool->order[pool->nextJob];
+			pool->nextJob++;
+		}
+		pthread_mutex_unlock(&pool->mutex);
+
+		if(!fileJob)
+		{
+			break;
+		}
+
+		convertFile(fileJob->filename, fileJob);
+
+		pthread_mutex_lock(&pool->mutex);
+		fileJob->done = true;
+		pthread_cond_broadcast(&pool->jobDone);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+	return NULL;
+}
+#endif /* !SSEQ2MID_NO_THREADS */
+
+/* convert input files on numThreads threads, outputs are put in order of files */
+void convertFilesInParallel(char* filename[], int numFiles, int numThreads)
+{
+#ifndef SSEQ2MID_NO_THREADS
+	Sseq2midFilePool pool;
+	Sseq2midFileJob* fileJob = (Sseq2midFileJob*) calloc(numFiles, sizeof(Sseq2midFileJob));
+	pthread_t* thread = (pthread_t*) malloc(sizeof(pthread_t) * numThreads);
+	int numStartedThreads = 0;
+	int fileIndex;
+
+	pool.order = (Sseq2midFileJob**) malloc(sizeof(Sseq2midFileJob*) * numFiles);
+	if(fileJob && thread && pool.order)
+	{
+		for(fileIndex = 0; fileIndex < numFiles; fileIndex++)
+		{
+			FILE* sseqFile = fopen(filename[fileIndex], "rb");
+
+			fileJob[fileIndex].filename = filename[fileIndex];
+			if(sseqFile)
+			{
+				fseek(sseqFile, 0, SEEK_END);
+				fileJob[fileIndex].fileSize = ftell(sseqFile);
+				fclose(sseqFile);
+			}
+			pool.order[fileIndex] = &fileJob[fileIndex];
+		}
+		qsort(pool.order, numFiles, sizeof(Sseq2midFileJob*), compareFileJobSize);
+		pool.numJobs = numFiles;
+		pool.nextJob = 0;
+
+		/* tracks are not split further, their warnings would share a buffer */
+		g_parallelTracks = false;
+
+		pthread_mutex_init(&pool.mutex, NULL);
+		pthread_cond_init(&pool.jobDone, NULL);
+		while((numStartedThreads < numThreads) && (numStartedThreads < numFiles))
+		{
+			if(pthread_create(&thread[numStartedThreads], NULL, fileJobWorker, &pool) != 0)
+			{
+				break;
+			}
+			numStartedThreads++;
+		}
+
+		/* put outputs in order of files, as soon as each one is done */
+		for(fileIndex = 0; fileIndex < numFiles; fileIndex++)
+		{
+			if(numStartedThreads > 0)
+			{
+				pthread_mutex_lock(&pool.mutex);
+				while(!fileJob[fileIndex].done)
+				{
+					pthread_cond_wait(&pool.jobDone, &pool.mutex);
+				}
+				pthread_mutex_unlock(&pool.mutex);
+			}
+			else
+			{
+				convertFile(fileJob[fileIndex].filename, NULL);
+			}
+
+			if(fileJob[fileIndex].text[0])
+			{
+				fputs(fileJob[fileIndex].text[0], stdout);
+			}
+			if(fileJob[fileIndex].text[1])
+			{
+				fputs(fileJob[fileIndex].text[1], stderr);
+			}
+			free(fileJob[fileIndex].text[0]);
+			free(fileJob[fileIndex].text[1]);
+		}
+
+		while(numStartedThreads > 0)
+		{
+			numStartedThreads--;
+			pthread_join(thread[numStartedThreads], NULL);
+		}
+		pthread_cond_destroy(&pool.jobDone);
+		pthread_mutex_destroy(&pool.mutex);
+	}
+	else
+	{
+		for(fileIndex = 0; fileIndex < numFiles; fileIndex++)
+		{
+			convertFile(filename[fileIndex], NULL);
+		}
+	}
+	free(pool.order);
+	free(thread);
+	free(fileJob);
+#else
+	int fileIndex;
+
+	for(fileIndex = 0; fileIndex < numFiles; fileIndex++)
+	{
+		convertFile(filename[fileIndex], NULL);
+	}
+#endif /* !SSEQ2MID_NO_THREADS */
+}
+
+/* sseq2mid application main */
+int main(int argc, char* argv[])
+{
+	int argi = 1;
+	int argci;
+
+	if(argc == 1) /* no arguments */
+	{
+		showUsage();
+	}
+	else
+	{
+		/* options */
+		while((argi < argc) && (argv[argi][0] == '-'))
+		{
+			if((strcmp(argv[argi], "-j") == 0) || (strcmp(argv[argi], "--jobs") == 0)) /* -j N */
+			{
+				if(!parseOptionCount(argv[argi], (argi + 1 < argc) ? argv[argi + 1] : NULL, &g_numJobs))
+				{
+					showUsage();
+					return 1;
+				}
+				argi++;
+			}
+			else if(strcmp(argv[argi], "--loops") == 0) /* --loops N */
+			{
+				if(!parseOptionCount(argv[argi], (argi + 1 < argc) ? argv[argi + 1] : NULL, &g_loopCount))
+				{
+					showUsage();
+					return 1;
+				}
+				argi++;
+			}
+			else if((strcmp(argv[argi], "-f") == 0) || (strcmp(argv[argi], "--filter") == 0)) /* -f PAT */
+			{
+				if((argi + 1 >= argc) || (argv[argi + 1][0] == '\0'))
+				{
+					char errorMsg[256];
+
+					snprintf(errorMsg, sizeof(errorMsg), "error: %s needs a pattern\n", argv[argi]);
+					dispatchWarningMsg(errorMsg, NULL);
+					showUsage();
+					return 1;
+				}
+				argi++;
+				g_sdatFilter = argv[argi];
+			}
+			else if(argv[argi][1] == '-') /* --string */
+			{
+				dispatchOptionStr(&argv[argi][2]);
+			}
+			else /* -letters (alphanumeric only) */
+			{
+				argci = 1;
+				while(argv[argi][argci] != '\0')
+				{
+					dispatchOptionChar(argv[argi][argci]);
+					argci++;
+				}
+			}
+			argi++;
+		}
+
+		/* input files */
+		if((g_numJobs > 1) && (argc - argi > 1))
+		{
+			convertFilesInParallel(&argv[argi], argc - argi, g_numJobs);
+		}
+		else
+		{
+			for(; argi < argc; argi++)
+			{
+				convertFile(argv[argi], NULL);
+			}
+		}
+	}
+	return 0;
+}
+#endif /* !SSEQ2MID_NO_MAIN */
+
+
+/* call the fuction to put log message */
+void sseq2midPutLog(Sseq2mid* sseq2mid, const char* logMessage)
+{
+	if(sseq2mid && sseq2mid->logProc)
+	{
+		sseq2mid->logProc(logMessage, sseq2mid->logUserData);
+	}
+}
+
+/* call the function to put warning message, or put it to stderr */
+void sseq2midPutWarning(Sseq2mid* sseq2mid, const char* warningMessage)
+{
+	if(sseq2mid && sseq2mid->warningProc)
+	{
+		sseq2mid->warningProc(warningMessage, sseq2mid->warningUserData);
+	}
+	else
+	{
+		fputs(warningMessage, stderr);
+	}
+}
+
+#define SSEQ2MID_MAX_DUMP	 5
+
+/* put log message in prescribed form */
+void sseq2midPutLogLine(Sseq2mid* sseq2mid, size_t offset, size_t size, 
+	const char* description, const char* comment)
+{
+	if(sseq2mid && sseq2mid->logProc)
+	{
+		const char* hexDigit = "0123456789ABCDEF";
+		char logMsg[192];
+		char hexDump[SSEQ2MID_MAX_DUMP * 3];
+		size_t sizeToTransfer = 0;
+		size_t transferedSize;
+		const byte* sseq = sseq2mid->sseq;
+		size_t sseqSize = sseq2mid->sseqSize;
+
+		if(offset < sseqSize)
+		{
+			sizeToTransfer = (size <= sseqSize - offset) ? size : sseqSize - offset;
+			sizeToTransfer = (sizeToTransfer < SSEQ2MID_MAX_DUMP) ? sizeToTransfer : SSEQ2MID_MAX_DUMP;
+		}
+
+		hexDump[0] = '\0';
+		for(transferedSize = 0; transferedSize < sizeToTransfer; transferedSize++)
+		{
+			byte value = sseq[offset + transferedSize];
+
+			hexDump[transferedSize * 3] = hexDigit[value >> 4];
+			hexDump[transferedSize * 3 + 1] = hexDigit[value & 0x0f];
+			hexDump[transferedSize * 3 + 2] = ' ';
+		}
+		if(sizeToTransfer > 0)
+		{
+			hexDump[sizeToTransfer * 3 - 1] = '\0';
+		}
+
+		snprintf(logMsg, sizeof(logMsg), "%08X: %-14s | %-20s | %s\n", (unsigned int) offset, hexDump, 
+			description ? description : "", comment ? comment : "");
+		sseq2midPutLog(sseq2mid, logMsg);
+	}
+}
+
+/* format name and description of a converted event */
+void sseq2midFormatEventLog(Sseq2mid* sseq2mid, const Sseq2midEventLog* eventLog, char* eventName, char* eventDesc)
+{
+	const SseqInstruction* instruction = eventLog->instruction;
+	const int* param;
+	const sseqCom* com;
+
+	strcpy(eventDesc, "");
+	if(!instruction)
+	{
+		sprintf(eventName, "Access Violation");
+		sprintf(eventDesc, "End of File at %08X", (unsigned int) sseq2mid->sseqSize);
+		return;
+	}
+
+	param = instruction->param;
+	if(instruction->command < 0x80)
+	{
+		const char* noteName[] = {
+			"C ", "C#", "D ", "D#", "E ", "F ", 
+			"F#", "G ", "G#", "A ", "A#", "B "
+		};
+
+		sprintf(eventName, "Note with Duration");
+		sprintf(eventDesc, "%s %d [%d]	vel:%-3d dur:%-3d", noteName[instruction->command % 12], 
+			(instruction->command / 12) - 1, instruction->command, param[0], param[1]);
+		return;
+	}
+
+	switch(instruction->command)
+	{
+	case 0x93:
+		sprintf(eventName, "Open Track");
+		sprintf(eventDesc, "Track %02d at %08Xh", param[0] + 1, param[1]);
+		return;
+
+	case 0x94:
+	case 0x95:
+		sprintf(eventName, "%s", (instruction->command == 0x94) ? "Jump" : "Call");
+		sprintf(eventDesc, "%08X", param[0]);
+		return;
+
+	case 0xa0:
+		sprintf(eventName, "Random (%02X)", instruction->subCommand);
+		sprintf(eventDesc, "Min:%d Max:%d", param[0], param[1]);
+		return;
+
+	case 0xa1:
+		sprintf(eventName, "From Var (%02X)", instruction->subCommand);
+		sprintf(eventDesc, "var %d", param[0]);
+		return;
+
+	case 0xa2:
+		sprintf(eventName, "If");
+		return;
+
+	case 0xb0:
+	case 0xb1:
+	case 0xb2:
+	case 0xb3:
+	case 0xb4:
+	case 0xb5:
+	case 0xb6:
+	case 0xb8:
+	case 0xb9:
+	case 0xba:
+	case 0xbb:
+	case 0xbc:
+	case 0xbd:
+		sprintf(eventName, "Variable %s", sseqVarMethodName[instruction->command - 0xb0]);
+		sprintf(eventDesc, "var %u : %d", (uint8_t) param[0], param[1]);
+		return;
+
+	case 0xc4:
+		sprintf(eventName, "Pitch Bend");
+		sprintf(eventDesc, "%d", param[0] * 64);
+		return;
+
+	case 0xc7:
+		sprintf(eventName, "Mono/Poly");
+		sprintf(eventDesc, "%s (%d)", param[0] ? "Mono" : "Poly", param[0]);
+		return;
+
+	case 0xcc:
+	{
+		const char* typeStr[] = { "Pitch", "Volume", "Pan" };
+
+		sprintf(eventName, "Modulation Type");
+		if(param[0] >= 0 && param[0] < countof(typeStr))
+		{
+			sprintf(eventDesc, "%s", typeStr[param[0]]);
+		}
+		else
+		{
+			sprintf(eventDesc, "%d", param[0]);
+		}
+		return;
+	}
+
+	case 0xd4:
+		sprintf(eventName, "Loop Start");
+		sprintf(eventDesc, "%d", eventLog->value);
+		return;
+
+	case 0xfd:
+		sprintf(eventName, "Return");
+		sprintf(eventDesc, "%08X", eventLog->value);
+		return;
+
+	case 0xfe:
+	{
+		unsigned int bit;
+		char* flagChar = eventDesc;
+
+		sprintf(eventName, "Signify Multi Track");
+		for(bit = 1; bit < 0x10000; bit = bit << 1)
+		{
+			*flagChar++ = (param[0] & bit) ? '*' : '-';
+		}
+		*flagChar = '\0';
+		return;
+	}
+	}
+
+	/* the rest are named by sseqComList */
+	com = sseqFindCom(instruction->command);
+	if(!com)
+	{
+		sprintf(eventName, "Unknown Event %02X", instruction->command);
+	}
+	else
+	{
+		sprintf(eventName, "%s", com->logName);
+		if(com->param1 == BOOLPARAM)
+		{
+			sprintf(eventDesc, "%s (%d)", param[0] ? "On" : "Off", param[0]);
+		}
+		else if(com->param1 != NOPARAM)
+		{
+			sprintf(eventDesc, "%d", param[0]);
+		}
+	}
+}
+
+/* filter: sseq channel number to midi track number */
+int sseq2midSseqChToMidiCh(Sseq2mid* sseq2mid, int sseqChannel)
+{
+	return ((sseqChannel >= 0) && (sseqChannel <= SSEQ_MAX_TRACK)) ? sseq2mid->chOrder[sseqChannel] : sseqChannel;
+}
+
+/* create sseq2mid object on sseq data, which is released by sseq2midDelete as storage says */
+Sseq2mid* sseq2midCreateOnData(const byte* sseq, size_t sseqSize, bool modifyChOrder, int storage)
+{
+	Sseq2mid* newSseq2mid = (Sseq2mid*) calloc(1, sizeof(Sseq2mid));
+
+	if(newSseq2mid)
+	{
+		newSseq2mid->smf = smfCreate();
+		if(newSseq2mid->smf)
+		{
+			newSseq2mid->sseq = sseq;
+			newSseq2mid->sseqSize = sseqSize;
+			newSseq2mid->sseqStorage = storage;
+
+			smfSetTimebase(newSseq2mid->smf, SSEQ_TIMEBASE);
+			newSseq2mid->loopCount = 1;
+			newSseq2mid->loopStyle = 0;
+			newSseq2mid->spacer = false;
+			newSseq2mid->noReverb = false;
+			newSseq2mid->modifyChOrder = modifyChOrder;
+		}
+		else
+		{
+			free(newSseq2mid);
+			newSseq2mid = NULL;
+		}
+	}
+	return newSseq2mid;
+}
+
+/* create sseq2mid object, sseq is copied */
+Sseq2mid* sseq2midCreate(const byte* sseq, size_t sseqSize, bool modifyChOrder)
+{
+	Sseq2mid* newSseq2mid = NULL;
+	byte* sseqCopy = (byte*) malloc(sseqSize ? sseqSize : 1);
+
+	if(sseqCopy)
+	{
+		memcpy(sseqCopy, sseq, sseqSize);
+		newSseq2mid = sseq2midCreateOnData(sseqCopy, sseqSize, modifyChOrder, SSEQ2MID_STORAGE_OWNED);
+		if(!newSseq2mid)
+		{
+			free(sseqCopy);
+		}
+	}
+	return newSseq2mid;
+}
+
+/* create sseq2mid object, sseq is borrowed and must outlive the object */
+Sseq2mid* sseq2midCreateBorrowed(const byte* sseq, size_t sseqSize, bool modifyChOrder)
+{
+	return sseq2midCreateOnData(sseq, sseqSize, modifyChOrder, SSEQ2MID_STORAGE_BORROWED);
+}
+
+/* create sseq2mid object from file, mapped read-only where possible */
+Sseq2mid* sseq2midCreateFromFile(const char* filename, bool modifyChOrder)
+{
+	Sseq2mid* newSseq2mid = NULL;
+	size_t sseqSize;
+	int storage;
+	const byte* sseq = sseq2midLoadFile(filename, &sseqSize, &storage);
+
+	if(sseq)
+	{
+		newSseq2mid = sseq2midCreateOnData(sseq, sseqSize, modifyChOrder, storage);
+		if(!newSseq2mid)
+		{
+			sseq2midReleaseData(sseq, sseqSize, storage);
+		}
+	}
+	return newSseq2mid;
+}
+
+/* load whole file, mapped read-only where possible, release it by sseq2midReleaseData */
+const byte* sseq2midLoadFile(const char* filename, size_t* dataSize, int* storage)
+{
+	FILE* dataFile;
+	const byte* data = NULL;
+
+#ifndef _WIN32
+	int dataFd = open(filename, O_RDONLY);
+
+	if(dataFd != -1)
+	{
+		struct stat dataStat;
+
+		if(fstat(dataFd, &dataStat) == 0)
+		{
+			if(S_ISDIR(dataStat.st_mode))
+			{
+				close(dataFd);
+				return NULL;
+			}
+			if(S_ISREG(dataStat.st_mode) && (dataStat.st_size > 0))
+			{
+				void* mappedData = mmap(NULL, (size_t) dataStat.st_size, PROT_READ, MAP_PRIVATE, dataFd, 0);
+
+				if(mappedData != MAP_FAILED)
+				{
+					close(dataFd);
+					*dataSize = (size_t) dataStat.st_size;
+					*storage = SSEQ2MID_STORAGE_MAPPED;
+					return (const byte*) mappedData;
+				}
+			}
+		}
+		close(dataFd);
+	}
+#endif
+
+	/* not mappable, read it into a buffer of its own */
+	dataFile = fopen(filename, "rb");
+	if(dataFile)
+	{
+		long fileSize;
+		size_t readSize = 0;
+		byte* buffer = NULL;
+
+		fseek(dataFile, 0, SEEK_END);
+		fileSize = ftell(dataFile);
+		rewind(dataFile);
+
+		if(fileSize >= 0)
+		{
+			readSize = (size_t) fileSize;
+			buffer = (byte*) malloc(readSize ? readSize : 1);
+		}
+		if(buffer)
+		{
+			if(fread(buffer, 1, readSize, dataFile) == readSize)
+			{
+				*dataSize = readSize;
+				*storage = SSEQ2MID_STORAGE_OWNED;
+				data = buffer;
+			}
+			else
+			{
+				free(buffer);
+			}
+		}
+
+		fclose(dataFile);
+	}
+	return data;
+}
+
+/* release data as its storage says */
+void sseq2midReleaseData(const byte* data, size_t dataSize, int storage)
+{
+	switch(storage)
+	{
+	case SSEQ2MID_STORAGE_OWNED:
+		free((void*) data);
+		break;
+
+#ifndef _WIN32
+	case SSEQ2MID_STORAGE_MAPPED:
+		munmap((void*) data, dataSize);
+		break;
+#endif
+	}
+}
+
+/* delete sseq2mid object */
+void sseq2midDelete(Sseq2mid* sseq2mid)
+{
+	if(sseq2mid)
+	{
+		sseq2midFreeJumpTargets(sseq2mid);
+		sseq2midFreeInstructions(sseq2mid);
+		smfDelete(sseq2mid->smf);
+		sseq2midReleaseData(sseq2mid->sseq, sseq2mid->sseqSize, sseq2mid->sseqStorage);
+		free(sseq2mid);
+	}
+}
+
+/* copy sseq2mid object */
+Sseq2mid* sseq2midCopy(Sseq2mid* sseq2mid)
+{
+	Sseq2mid* newSseq2mid = NULL;
+
+	if(sseq2mid)
+	{
+		newSseq2mid = sseq2midCreate(sseq2mid->sseq, sseq2mid->sseqSize, sseq2mid->modifyChOrder);
+		if(newSseq2mid)
+		{
+			smfDelete(newSseq2mid->smf);
+			newSseq2mid->smf = smfCopy(sseq2mid->smf);
+			if(newSseq2mid->smf)
+			{
+				sseq2midSetLogProc(newSseq2mid, sseq2mid->logProc, sseq2mid->logUserData);
+				sseq2midSetWarningProc(newSseq2mid, sseq2mid->warningProc, sseq2mid->warningUserData);
+				sseq2midSetLoopStyle(newSseq2mid, sseq2mid->loopStyle);
+				sseq2midUseSpacer(newSseq2mid, sseq2mid->spacer);
+				sseq2midSetLoopCount(newSseq2mid, sseq2mid->loopCount);
+				sseq2midNoReverb(newSseq2mid, sseq2mid->noReverb);
+				sseq2midParallelTracks(newSseq2mid, sseq2mid->parallelTracks);
+			}
+			else
+			{
+				sseq2midDelete(newSseq2mid);
+				newSseq2mid = NULL;
+			}
+		}
+	}
+	return newSseq2mid;
+}
+
+/* collect offsets that may be jumped to, so that the time at them can be remembered.
+   every 0x94 byte is taken for a jump, which may find some extra targets, but never misses one */
+bool sseq2midIndexJumpTargets(Sseq2mid* sseq2mid, size_t sseqOffsetBase)
+{
+	const byte* sseq = sseq2mid->sseq;
+	size_t sseqSize = sseq2mid->sseqSize;
+	size_t offset;
+	size_t targetIndex = 0;
+	size_t numTargets = 0;
+
+	sseq2midFreeJumpTargets(sseq2mid);
+	sseq2mid->jumpTargetMap = (byte*) calloc((sseqSize + 7) / 8, 1);
+	if(!sseq2mid->jumpTargetMap)
+	{
+		return false;
+	}
+
+	for(offset = 0; offset + 4 <= sseqSize; offset++)
+	{
+		if(sseq[offset] == 0x94)
+		{
+			size_t target = getU3LitFrom(&sseq[offset + 1]) + sseqOffsetBase;
+
+			/* nothing is ever recorded beyond the end */
+			if((target < sseqSize) && !(sseq2mid->jumpTargetMap[target / 8] & (1 << (target % 8))))
+			{
+				sseq2mid->jumpTargetMap[target / 8] |= (1 << (target % 8));
+				numTargets++;
+			}
+		}
+	}
+
+	if(numTargets > 0)
+	{
+		sseq2mid->jumpTarget = (size_t*) malloc(numTargets * sizeof(size_t));
+		sseq2mid->jumpTargetAbsTime = (int*) calloc(numTargets * SSEQ_MAX_TRACK, sizeof(int));
+		if(!sseq2mid->jumpTarget || !sseq2mid->jumpTargetAbsTime)
+		{
+			sseq2midFreeJumpTargets(sseq2mid);
+			return false;
+		}
+
+		/* walking the bitmap gives them in order */
+		for(offset = 0; offset < sseqSize; offset++)
+		{
+			if(sseq2mid->jumpTargetMap[offset / 8] & (1 << (offset % 8)))
+			{
+				sseq2mid->jumpTarget[targetIndex++] = offset;
+			}
+		}
+	}
+	sseq2mid->numJumpTargets = numTargets;
+	return true;
+}
+
+/* release jump target index */
+void sseq2midFreeJumpTargets(Sseq2mid* sseq2mid)
+{
+	free(sseq2mid->jumpTarget);
+	free(sseq2mid->jumpTargetMap);
+	free(sseq2mid->jumpTargetAbsTime);
+	sseq2mid->jumpTarget = NULL;
+	sseq2mid->jumpTargetMap = NULL;
+	sseq2mid->jumpTargetAbsTime = NULL;
+	sseq2mid->numJumpTargets = 0;
+}
+
+/* find the index of jump target, or numJumpTargets if offset is not a target */
+size_t sseq2midFindJumpTarget(Sseq2mid* sseq2mid, size_t offset)
+{
+	size_t low = 0;
+	size_t high = sseq2mid->numJumpTargets;
+
+	if((offset < sseq2mid->sseqSize) && sseq2mid->jumpTargetMap && 
+			(sseq2mid->jumpTargetMap[offset / 8] & (1 << (offset % 8))))
+	{
+		while(low < high)
+		{
+			size_t middle = (low + high) / 2;
+
+			if(sseq2mid->jumpTarget[middle] < offset)
+			{
+				low = middle + 1;
+			}
+			else
+			{
+				high = middle;
+			}
+		}
+		return low;
+	}
+	return sseq2mid->numJumpTargets;
+}
+
+/* remember the time of the track at offset, if it is a jump target */
+void sseq2midSetAbsTimeAt(Sseq2mid* sseq2mid, int trackIndex, size_t offset, int absTime)
+{
+	size_t targetIndex = sseq2midFindJumpTarget(sseq2mid, offset);
+
+	if(targetIndex < sseq2mid->numJumpTargets)
+	{
+		sseq2mid->jumpTargetAbsTime[trackIndex * sseq2mid->numJumpTargets + targetIndex] = absTime;
+	}
+}
+
+/* time of the track when it last passed offset, 0 if it never did */
+int sseq2midGetAbsTimeAt(Sseq2mid* sseq2mid, int trackIndex, size_t offset)
+{
+	size_t targetIndex = sseq2midFindJumpTarget(sseq2mid, offset);
+
+	if(targetIndex < sseq2mid->numJumpTargets)
+	{
+		return sseq2mid->jumpTargetAbsTime[trackIndex * sseq2mid->numJumpTargets + targetIndex];
+	}
+	return 0;
+}
+
+/* read a parameter of the given type, offsets are left relative.
+   the caller has made sure that sseqGetParamSize bytes are there */
+int readParamOfType(int sseqParamType, const byte* sseq, size_t* curOffset)
+{
+	int value = 0;
+
+	switch(sseqParamType)
+	{
+	case BOOLPARAM:
+	case U8PARAM:
+	case HEXU8PARAM:
+		value = getU1From(&sseq[*curOffset]);
+		(*curOffset)++;
+		break;
+
+	case S8PARAM:
+		value = getS1From(&sseq[*curOffset]);
+		(*curOffset)++;
+		break;
+
+	case S16PARAM:
+		value = getS2LitFrom(&sseq[*curOffset]);
+		*curOffset += 2;
+		break;
+
+	case U16PARAM:
+		value = getU2LitFrom(&sseq[*curOffset]);
+		*curOffset += 2;
+		break;
+
+	case HEXU24PARAM:
+		value = getU3LitFrom(&sseq[*curOffset]);
+		*curOffset += 3;
+		break;
+
+	case VARLENPARAM:
+		value = smfReadVarLength(&sseq[*curOffset], SSEQ_VARLEN_MAX);
+		*curOffset += smfGetVarLengthSize(value);
+		break;
+	}
+	return value;
+}
+
+/* most bytes that a parameter of the given type takes */
+size_t sseqGetParamSize(int sseqParamType)
+{
+	switch(sseqParamType)
+	{
+	case BOOLPARAM:
+	case U8PARAM:
+	case HEXU8PARAM:
+	case S8PARAM:
+		return 1;
+
+	case S16PARAM:
+	case U16PARAM:
+		return 2;
+
+	case HEXU24PARAM:
+		return 3;
+
+	case VARLENPARAM:
+		return SSEQ_VARLEN_MAX;
+	}
+	return 0;
+}
+
+/* find sseqComList entry of the command, NULL if unknown */
+const sseqCom* sseqFindCom(byte commandByte)
+{
+#ifndef SSEQ2MID_NO_THREADS
+	pthread_once(&sseqComTableOnce, sseqBuildComTable);
+#else
+	if(!sseqComTableBuilt)
+	{
+		sseqBuildComTable();
+	}
+#endif
+	return sseqComTable[commandByte];
+}
+
+/* build the dispatch table indexed by command byte */
+void sseqBuildComTable(void)
+{
+	size_t comIndex;
+
+	for(comIndex = 0; comIndex < sseqComListLen; comIndex++)
+	{
+		sseqComTable[sseqComList[comIndex].commandByte] = &sseqComList[comIndex];
+	}
+	for(comIndex = 0; comIndex < 256; comIndex++)
+	{
+		sseqMaxOperandSize[comIndex] = (byte) sseqGetMaxOperandSize((byte) comIndex);
+	}
+	sseqComTableBuilt = true;
+}
+
+/* most bytes that parameters of a command take, as sseqDecodeInstruction reads them */
+size_t sseqGetMaxOperandSize(byte commandByte)
+{
+	const sseqCom* com = sseqComTable[commandByte];
+
+	if(commandByte < 0x80)
+	{
+		/* velocity, duration */
+		return 1 + SSEQ_VARLEN_MAX;
+	}
+
+	switch(commandByte)
+	{
+	case 0x80:
+	case 0x81:
+		return SSEQ_VARLEN_MAX;
+
+	case 0x93:
+		return 1 + 3;
+
+	case 0x94:
+	case 0x95:
+		return 3;
+
+	case 0xa0:
+		return 1 + 2 + 2;
+
+	case 0xa1:
+		/* command, (extra byte of a var command), var */
+		return 1 + 1 + 1;
+
+	case 0xa2:
+	{
+		/* command and the parameters of the longest one */
+		size_t maxSize = 0;
+		int subCommandByte;
+
+		for(subCommandByte = 0; subCommandByte < 256; subCommandByte++)
+		{
+			if((subCommandByte != 0xa2) && (sseqGetMaxOperandSize((byte) subCommandByte) > maxSize))
+			{
+				maxSize = sseqGetMaxOperandSize((byte) subCommandByte);
+			}
+		}
+		return 1 + maxSize;
+	}
+
+	case 0xb0:
+	case 0xb1:
+	case 0xb2:
+	case 0xb3:
+	case 0xb4:
+	case 0xb5:
+	case 0xb6:
+	case 0xb8:
+	case 0xb9:
+	case 0xba:
+	case 0xbb:
+	case 0xbc:
+	case 0xbd:
+		return 1 + 2;
+
+	case 0xe0:
+		return 2;
+	}
+
+	if(com)
+	{
+		return sseqGetParamSize(com->param1) + sseqGetParamSize(com->param2) + sseqGetParamSize(com->param3);
+	}
+	return 0;
+}
+
+/* most bytes that a command takes, including the command byte */
+size_t sseqGetMaxInstructionSize(byte commandByte)
+{
+#ifndef SSEQ2MID_NO_THREADS
+	pthread_once(&sseqComTableOnce, sseqBuildComTable);
+#else
+	if(!sseqComTableBuilt)
+	{
+		sseqBuildComTable();
+	}
+#endif
+	return 1 + sseqMaxOperandSize[commandByte];
+}
+
+/* format a command as a text marker, "Name:param1,param2,param3" */
+void formatComMarker(char* outputText, const sseqCom* com, const int* param)
+{
+	const int paramType[3] = {
+		com ? com->param1 : NOPARAM, com ? com->param2 : NOPARAM, com ? com->param3 : NOPARAM
+	};
+	int paramIndex;
+
+	strcpy(outputText, com ? com->commandName : "Unknown");
+	strcat(outputText, ":");
+	for(paramIndex = 0; (paramIndex < 3) && (paramType[paramIndex] != NOPARAM); paramIndex++)
+	{
+		char paramValText[12];
+
+		if(paramIndex > 0)
+		{
+			strcat(outputText, ",");
+		}
+		formatParamOfType(paramValText, paramType[paramIndex], param[paramIndex]);
+		strcat(outputText, paramValText);
+	}
+}
+
+/* whether the converter understands the command */
+bool sseqIsKnownCommand(byte commandByte)
+{
+	return (commandByte < 0x80) || (commandByte >= 0xb0 && commandByte <= 0xbd && commandByte != 0xb7) 
+		|| (sseqFindCom(commandByte) != NULL);
+}
+
+/* decode a command at offset into instruction, returns its size.
+   returns 0 (and length 0) if the command is cut off by the end of sseq */
+size_t sseqDecodeInstruction(const byte* sseq, size_t sseqSize, size_t offset, size_t sseqOffsetBase, SseqInstruction* instruction)
+{
+	byte paddedCommand[1 + SSEQ_MAX_OPERAND_SIZE];
+	const byte* command = &sseq[offset];
+	size_t curOffset = 0;
+	byte statusByte;
+
+	memset(instruction, 0, sizeof(SseqInstruction));
+	instruction->offset = (uint32_t) offset;
+	if(offset >= sseqSize)
+	{
+		return 0;
+	}
+
+	/* a single check for the longest form of the command, then parameters are read without checks */
+	if(sseqGetMaxInstructionSize(sseq[offset]) > sseqSize - offset)
+	{
+		/* near the end, read a copy padded with zeros and see if the command fits after all */
+		memset(paddedCommand, 0, sizeof(paddedCommand));
+		memcpy(paddedCommand, &sseq[offset], sseqSize - offset);
+		command = paddedCommand;
+	}
+
+	statusByte = getU1From(&command[curOffset]);
+	curOffset++;
+	instruction->command = statusByte;
+
+	if(statusByte < 0x80)
+	{
+		/* note: velocity, duration */
+		instruction->param[0] = readParamOfType(U8PARAM, command, &curOffset);
+		instruction->param[1] = readParamOfType(VARLENPARAM, command, &curOffset);
+	}
+	else
+	{
+		switch(statusByte)
+		{
+		case 0x80:
+		case 0x81:
+			instruction->param[0] = readParamOfType(VARLENPARAM, command, &curOffset);
+			break;
+
+		case 0x93:
+			instruction->param[0] = readParamOfType(U8PARAM, command, &curOffset);
+			instruction->param[1] = readParamOfType(HEXU24PARAM, command, &curOffset) + sseqOffsetBase;
+			break;
+
+		case 0x94:
+		case 0x95:
+			instruction->param[0] = readParamOfType(HEXU24PARAM, command, &curOffset) + sseqOffsetBase;
+			break;
+
+		case 0xa0:
+			instruction->subCommand = readParamOfType(HEXU8PARAM, command, &curOffset);
+			instruction->param[0] = readParamOfType(S16PARAM, command, &curOffset);
+			instruction->param[1] = readParamOfType(S16PARAM, command, &curOffset);
+			break;
+
+		case 0xa1:
+			/* command, var: a var command has an extra byte before var number */
+			instruction->subCommand = readParamOfType(HEXU8PARAM, command, &curOffset);
+			if(instruction->subCommand >= 0xb0 && instruction->subCommand <= 0xbd)
+			{
+				curOffset++;
+			}
+			instruction->param[0] = readParamOfType(U8PARAM, command, &curOffset);
+			break;
+
+		case 0xa2:
+		{
+			byte subStatusByte = readParamOfType(HEXU8PARAM, command, &curOffset);
+
+			instruction->subCommand = subStatusByte;
+			if(subStatusByte == 0xa1)
+			{
+				instruction->param[0] = readParamOfType(HEXU8PARAM, command, &curOffset);
+				if(instruction->param[0] >= 0xb0 && instruction->param[0] <= 0xbd)
+				{
+					curOffset++;
+				}
+				instruction->param[1] = readParamOfType(U8PARAM, command, &curOffset);
+			}
+			else if((subStatusByte >= 0xb0 && subStatusByte <= 0xb6) || (subStatusByte >= 0xb8 && subStatusByte <= 0xbd))
+			{
+				instruction->param[0] = readParamOfType(U8PARAM, command, &curOffset);
+				instruction->param[1] = readParamOfType(S16PARAM, command, &curOffset);
+			}
+			else if(subStatusByte < 0x80)
+			{
+				instruction->param[0] = readParamOfType(U8PARAM, command, &curOffset);
+				instruction->param[1] = readParamOfType(VARLENPARAM, command, &curOffset);
+			}
+			else if(subStatusByte == 0x94)
+			{
+				instruction->param[0] = readParamOfType(HEXU24PARAM, command, &curOffset) + sseqOffsetBase;
+			}
+			else
+			{
+				const sseqCom* com = sseqFindCom(subStatusByte);
+
+				if(com)
+				{
+					instruction->param[0] = readParamOfType(com->param1, command, &curOffset);
+					instruction->param[1] = readParamOfType(com->param2, command, &curOffset);
+					instruction->param[2] = readParamOfType(com->param3, command, &curOffset);
+				}
+			}
+			break;
+		}
+
+		case 0xb0:
+		case 0xb1:
+		case 0xb2:
+		case 0xb3:
+		case 0xb4:
+		case 0xb5:
+		case 0xb6:
+		case 0xb8:
+		case 0xb9:
+		case 0xba:
+		case 0xbb:
+		case 0xbc:
+		case 0xbd:
+			/* var number, value */
+			instruction->param[0] = readParamOfType(U8PARAM, command, &curOffset);
+			instruction->param[1] = readParamOfType(S16PARAM, command, &curOffset);
+			break;
+
+		case 0xe0:
+			/* raw value, it is signed only in the marker */
+			instruction->param[0] = readParamOfType(U16PARAM, command, &curOffset);
+			break;
+
+		default:
+		{
+			/* others follow the parameter types of sseqComList (nothing to read, if unknown) */
+			const sseqCom* com = sseqFindCom(statusByte);
+
+			if(com)
+			{
+				instruction->param[0] = readParamOfType(com->param1, command, &curOffset);
+				instruction->param[1] = readParamOfType(com->param2, command, &curOffset);
+				instruction->param[2] = readParamOfType(com->param3, command, &curOffset);
+			}
+			break;
+		}
+		}
+	}
+
+	if(curOffset > sseqSize - offset)
+	{
+		return 0;
+	}
+	instruction->length = (uint16_t) curOffset;
+	return curOffset;
+}
+
+int sseqCompareInstructionOffset(const void* a, const void* b)
+{
+	uint32_t offsetA = ((const SseqInstruction*) a)->offset;
+	uint32_t offsetB = ((const SseqInstruction*) b)->offset;
+
+	return (offsetA > offsetB) - (offsetA < offsetB);
+}
+
+/* decode every command reachable from the top of sequence, just once, into a new array sorted by offset.
+   commands are followed along the flow of each track, as data may be placed among them;
+   decodeProc, if not NULL, is called on each command as it is decoded */
+bool sseqDecodeFlow(const byte* sseq, size_t sseqSize, size_t sseqOffsetBase, SseqDecodeProc* decodeProc, void* userData, SseqInstruction** instruction, size_t* numInstructions)
+{
+	SseqInstruction* decoded = NULL;
+	size_t numDecoded = 0;
+	size_t maxDecoded = 0;
+	byte* decodedMap;
+	size_t* pendingOffset;
+	size_t numPendingOffsets = 0;
+	size_t maxPendingOffsets = 16;
+	bool result = true;
+
+	*instruction = NULL;
+	*numInstructions = 0;
+	decodedMap = (byte*) calloc((sseqSize + 7) / 8, 1);
+	pendingOffset = (size_t*) malloc(maxPendingOffsets * sizeof(size_t));
+	if(!decodedMap || !pendingOffset)
+	{
+		free(decodedMap);
+		free(pendingOffset);
+		return false;
+	}
+
+	/* track 0 starts right after the header */
+	pendingOffset[numPendingOffsets++] = 0x1c;
+
+	while(result && numPendingOffsets > 0)
+	{
+		size_t curOffset = pendingOffset[--numPendingOffsets];
+		bool endOfFlow = false;
+
+		while(!endOfFlow && (curOffset < sseqSize) && !(decodedMap[curOffset / 8] & (1 << (curOffset % 8))))
+		{
+			SseqInstruction* newInstruction;
+			size_t branchOffset;
+
+			if(numDecoded == maxDecoded)
+			{
+				size_t newMaxDecoded = maxDecoded ? (maxDecoded * 2) : 256;
+				SseqInstruction* newDecoded = (SseqInstruction*) realloc(decoded, newMaxDecoded * sizeof(SseqInstruction));
 
-								case 0x81:
-								{
-									int realProgram;
-									int bankMsb;
-									int bankLsb;
-									int program;
-
-									realProgram = smfReadVarLength(&sseq[curOffset], sseqSize - curOffset);
-									curOffset += smfGetVarLengthSize(realProgram);
-
-									program = realProgram % 128;
-									bankLsb = (realProgram / 128) % 128;
-									bankMsb = (realProgram / 128 / 128) % 128;
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_BANKSELM, bankMsb);
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_BANKSELL, bankLsb);
-									smfInsertProgram(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, program);
-
-									sprintf(eventName, "Program Change");
-									sprintf(eventDesc, "%d", realProgram);
-									break;
-								}
+				if(!newDecoded)
+				{
+					result = false;
+					break;
+				}
+				decoded = newDecoded;
+				maxDecoded = newMaxDecoded;
+			}
 
-								case 0x93: /* ('A`) */
-								{
-									int newTrackIndex;
-									int offset;
-
-									newTrackIndex = getU1From(&sseq[curOffset]);
-									curOffset += 1;
-									offset = getU3LitFrom(&sseq[curOffset]) + sseqOffsetBase;
-									curOffset += 3;
-
-									sseq2mid->track[newTrackIndex].loopCount = loopCount;
-									sseq2mid->track[newTrackIndex].absTime = absTime;
-									sseq2mid->track[newTrackIndex].offsetToTop = offset;
-									sseq2mid->track[newTrackIndex].offsetToReturn = SSEQ_INVALID_OFFSET;
-									sseq2mid->track[newTrackIndex].curOffset = offset;
-
-									sprintf(eventName, "Open Track");
-									sprintf(eventDesc, "Track %02d at %08Xh", newTrackIndex + 1, offset);
-									break;
-								}
+			newInstruction = &decoded[numDecoded++];
+			decodedMap[curOffset / 8] |= (1 << (curOffset % 8));
+			if(sseqDecodeInstruction(sseq, sseqSize, curOffset, sseqOffsetBase, newInstruction) == 0)
+			{
+				/* cut off by the end of sseq */
+				numDecoded--;
+				break;
+			}
+			curOffset += newInstruction->length;
+			if(decodeProc)
+			{
+				decodeProc(newInstruction, userData);
+			}
+
+			endOfFlow = !sseqGoesOn(newInstruction);
+			branchOffset = sseqGetBranch(newInstruction);
+			if(branchOffset < sseqSize)
+			{
+				if(numPendingOffsets == maxPendingOffsets)
+				{
+					size_t* newPendingOffset = (size_t*) realloc(pendingOffset, maxPendingOffsets * 2 * sizeof(size_t));
+
+					if(!newPendingOffset)
+					{
+						result = false;
+						break;
+					}
+					pendingOffset = newPendingOffset;
+					maxPendingOffsets *= 2;
+				}
+				pendingOffset[numPendingOffsets++] = branchOffset;
+			}
+		}
+	}
+
+	if(result)
+	{
+		qsort(decoded, numDecoded, sizeof(SseqInstruction), sseqCompareInstructionOffset);
+		*instruction = decoded;
+		*numInstructions = numDecoded;
+	}
+	else
+	{
+		free(decoded);
+	}
+	free(pendingOffset);
+	free(decodedMap);
+	return result;
+}
+
+/* check if the flow may go on to the command right after */
+bool sseqGoesOn(const SseqInstruction* instruction)
+{
+	switch(instruction->command)
+	{
+	case 0x94:
+	case 0xfd:
+	case 0xff:
+		return false;
+
+	default:
+		/* unknown command stops the track */
+		return sseqIsKnownCommand(instruction->command);
+	}
+}
+
+/* target offset of a command, SSEQ_INVALID_OFFSET if it doesn't branch */
+size_t sseqGetBranch(const SseqInstruction* instruction)
+{
+	switch(instruction->command)
+	{
+	case 0x93:
+		return (size_t) instruction->param[1];
+
+	case 0x94:
+	case 0x95:
+		return (size_t) instruction->param[0];
+
+	case 0xa2:
+		if(instruction->subCommand == 0x94)
+		{
+			return (size_t) instruction->param[0];
+		}
+		break;
+	}
+	return SSEQ_INVALID_OFFSET;
+}
+
+/* decode the commands of sequence ahead of conversion */
+bool sseq2midDecode(Sseq2mid* sseq2mid, size_t sseqOffsetBase)
+{
+	sseq2midFreeInstructions(sseq2mid);
+	return sseqDecodeFlow(sseq2mid->sseq, sseq2mid->sseqSize, sseqOffsetBase, NULL, NULL, &sseq2mid->instruction, &sseq2mid->numInstructions);
+}
+
+/* release decoded instructions */
+void sseq2midFreeInstructions(Sseq2mid* sseq2mid)
+{
+	free(sseq2mid->instruction);
+	sseq2mid->instruction = NULL;
+	sseq2mid->numInstructions = 0;
+}
+
+/* get decoded instruction at offset, hint is the index of previous instruction of the track.
+   commands out of decoded flow are decoded into scratch on demand, NULL if cut off by the end of sseq */
+const SseqInstruction* sseq2midGetInstruction(Sseq2mid* sseq2mid, size_t offset, size_t sseqOffsetBase, size_t* hint, SseqInstruction* scratch)
+{
+	size_t low = 0;
+	size_t high = sseq2mid->numInstructions;
+
+	/* mostly the next one */
+	if((*hint + 1 < high) && (sseq2mid->instruction[*hint + 1].offset == offset))
+	{
+		(*hint)++;
+		return &sseq2mid->instruction[*hint];
+	}
+
+	while(low < high)
+	{
+		size_t middle = (low + high) / 2;
+
+		if(sseq2mid->instruction[middle].offset < offset)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	if((low < sseq2mid->numInstructions) && (sseq2mid->instruction[low].offset == offset))
+	{
+		*hint = low;
+		return &sseq2mid->instruction[low];
+	}
+
+	if(sseqDecodeInstruction(sseq2mid->sseq, sseq2mid->sseqSize, offset, sseqOffsetBase, scratch) == 0)
+	{
+		return NULL;
+	}
+	return scratch;
+}
+
+/* set up the conversion of a track into smf */
+void sseq2midInitTrackJob(Sseq2midTrackJob* job, Sseq2mid* sseq2mid, int trackIndex, Smf* smf, size_t sseqOffsetBase, Sseq2midLoopPoints* loopPoints)
+{
+	job->sseq2mid = sseq2mid;
+	job->trackIndex = trackIndex;
+	job->smf = smf;
+	job->sseqOffsetBase = sseqOffsetBase;
+	job->loopPoints = loopPoints;
+	job->isolated = false;
+	job->needsSerial = false;
+	job->result = true;
+}
+
+/* convert a track from its current state, until it ends */
+void sseq2midConvertTrack(Sseq2midTrackJob* job)
+{
+	Sseq2mid* sseq2mid = job->sseq2mid;
+	Smf* smf = job->smf;
+	int trackIndex = job->trackIndex;
+	size_t sseqOffsetBase = job->sseqOffsetBase;
+	size_t sseqSize = sseq2mid->sseqSize;
+	int midiCh = sseq2midSseqChToMidiCh(sseq2mid, trackIndex);
+	int loopStartCount = 0;
+	size_t loopStartOffset = 0;
+	int loopCount = sseq2mid->track[trackIndex].loopCount;
+	
+	int stackedEventTimeSpacer = 0; // used to space out midi events that, in the original sseq, happen at the same time (but in a specific order). The spacer ensures that the order of events is the same as in the sseq.
+	
+	uint8_t jumpIndex=0;
+	
+	byte prevStatusByte=0x00;
+	size_t instructionHint = 0;
+	SseqInstruction scratchInstruction;
+
+	/* subroutines and loop repeats are copied from their first pass, unless the log or spacer wants every event */
+	bool copyEvents = !sseq2mid->logProc && !sseq2mid->spacer;
+	Sseq2midCallCache callCache = { NULL, 0, 0 };
+	Sseq2midLoopBody loopBody = { SSEQ_INVALID_OFFSET, 0, 0, 0, 0, false };
+	Sseq2midCallBlock callRecord[SSEQ_MAX_CALL_DEPTH];
+	int callIndex;
+
+	for(callIndex = 0; callIndex < SSEQ_MAX_CALL_DEPTH; callIndex++)
+	{
+		callRecord[callIndex].cacheable = false;
+	}
+
+	if(loopCount > 0)
+	{
+		do
+		{
+			int absTime = sseq2mid->track[trackIndex].absTime; // absTime does not persist through each loop, but sseq2mid->track[trackIndex].absTime does. All assignments to absTime go to sseq2mid->track[trackIndex].absTime
+			size_t curOffset = sseq2mid->track[trackIndex].curOffset;
+			size_t eventOffset = curOffset;
+			const SseqInstruction* instruction = NULL;
+			int eventLogValue = 0;
+			bool eventException;
+			size_t eventExceptionOffset = curOffset;
+			size_t offsetToJump = SSEQ_INVALID_OFFSET;
+
+			midiCh = sseq2midSseqChToMidiCh(sseq2mid, trackIndex);
+			eventException = true;
+
+			if(curOffset < sseqSize)
+			{
+				sseq2midSetAbsTimeAt(sseq2mid, trackIndex, curOffset, absTime);
+				instruction = sseq2midGetInstruction(sseq2mid, curOffset, sseqOffsetBase, &instructionHint, &scratchInstruction);
+			}
+
+			/* NULL past the end of sseq, or for a command cut off by it */
+			if(instruction)
+			{
+				byte statusByte;
+
+				statusByte = instruction->command;
+				curOffset += instruction->length;
+
+				/* a track converted apart can't touch the state of other tracks */
+				if(job->isolated && (statusByte == 0x93 || statusByte == 0xfe))
+				{
+					job->needsSerial = true;
+					free(callCache.block);
+					return;
+				}
+
+				/* a subroutine that loops, jumps, changes tracks, or is jumped into, can't be replayed */
+				if(sseq2mid->track[trackIndex].callDepth > 0)
+				{
+					if((statusByte == 0x93) || (statusByte == 0x94) || (statusByte == 0xd4) || (statusByte == 0xfc) || 
+							(statusByte == 0xfe) || (statusByte == 0xff) || 
+							((statusByte == 0xa2) && (instruction->subCommand == 0x94)) || 
+							(sseq2midFindJumpTarget(sseq2mid, eventOffset) < sseq2mid->numJumpTargets))
+					{
+						callRecord[sseq2mid->track[trackIndex].callDepth - 1].cacheable = false;
+					}
+				}
+
+				/* a loop body starts at a jump target, later passes of it must not differ from the first */
+				if(copyEvents)
+				{
+					if(sseq2midFindJumpTarget(sseq2mid, eventOffset) < sseq2mid->numJumpTargets)
+					{
+						sseq2midStartLoopBody(&loopBody, eventOffset, smf, midiCh, absTime, sseq2mid->track[trackIndex].callDepth);
+					}
+					if((statusByte == 0x93) || (statusByte == 0xfe) || (statusByte == 0xff) || 
+							((statusByte == 0xa2) && (instruction->subCommand == 0x94)))
+					{
+						loopBody.repeatable = false;
+					}
+				}
+
+				eventException = false;
+
+				if(statusByte < 0x80)
+				{
+					if (sseq2mid->spacer) {
+						if (prevStatusByte < 0x80) stackedEventTimeSpacer--;
+					}
+					
+					int velocity;
+					int duration;
+
+					velocity = instruction->param[0];
+					duration = instruction->param[1];
+
+					smfInsertNote(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, statusByte, velocity, duration);
+					if(sseq2mid->track[trackIndex].noteWait)
+					{
+						absTime += duration;
+						stackedEventTimeSpacer=0;
+					}
+
+				}
+				else
+				{
+					switch(statusByte) // Match sseq commands with equivalent midi commands, and if no equivalent midi commands exist, match them with undefined midi CCs. This program is compatible with my fork of midi2sseq, and it is possible to convert back and forth between sseq and midi (mostly) losslessly.
+					{
+					case 0x80:
+					{
+						int tick;
+
+						tick = instruction->param[0];
+
+						absTime += tick;
+						
+						stackedEventTimeSpacer=0;
+
+						break;
+					}
+
+					case 0x81:
+					{
+						int realProgram;
+						int bankMsb;
+						int bankLsb;
+						int program;
+
+						realProgram = instruction->param[0];
 
-								case 0x94:
+						program = realProgram % 128;
+						bankLsb = (realProgram / 128) % 128;
+						bankMsb = (realProgram / 128 / 128) % 128;
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_BANKSELM, bankMsb);
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_BANKSELL, bankLsb);
+						smfInsertProgram(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, program);
+
+						break;
+					}
+
+					case 0x93: /* ('A`) */
+					{
+						int newTrackIndex;
+						int offset;
+
+						newTrackIndex = instruction->param[0];
+						offset = instruction->param[1];
+
+						if(newTrackIndex >= SSEQ_MAX_TRACK)
+						{
+							eventException = true;
+							break;
+						}
+
+						sseq2mid->track[newTrackIndex].loopCount = loopCount;
+						sseq2mid->track[newTrackIndex].absTime = absTime;
+						sseq2mid->track[newTrackIndex].offsetToTop = offset;
+						sseq2mid->track[newTrackIndex].callDepth = 0;
+						sseq2mid->track[newTrackIndex].curOffset = offset;
+
+						break;
+					}
+
+					case 0x94:
+					{
+						int newOffset;
+						if (sseq2mid->loopStyle == 3) {
+							newOffset = instruction->param[0];
+							//
+							//char markerText[14]; // Jump:0x010101
+							//snprintf(markerText, 14, "Jump:0x%06X", newOffset);
+							//smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 13);
+							
+							char markerText[9]; // Jump:255
+							char markerText2[13]; // JumpPoint255
+							snprintf(markerText, 9, "Jump:%u", jumpIndex);
+							snprintf(markerText2, 13, "JumpPoint%u", jumpIndex);
+							smfInsertMetaEvent(smf, sseq2midGetAbsTimeAt(sseq2mid, trackIndex, newOffset), midiCh, 6, markerText2, 12);
+							smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 8);
+							jumpIndex++;
+						} else {
+							newOffset = instruction->param[0];
+							
+							offsetToJump = newOffset;
+							
+							if(offsetToJump >= sseq2mid->track[trackIndex].offsetToTop)
+							{
+								if(offsetToJump < curOffset)
 								{
-									int newOffset;
-									if (g_loopStyle == 3) {
-										newOffset = getU3LitFrom(&sseq[curOffset]) + sseqOffsetBase;
-										curOffset += 3;
-										//
-										//char markerText[14]; // Jump:0x010101
-										//snprintf(markerText, 14, "Jump:0x%06X", newOffset);
-										//smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 13);
-										
-										char markerText[9]; // Jump:255
-										char markerText2[13]; // JumpPoint255
-										snprintf(markerText, 9, "Jump:%u", jumpIndex);
-										snprintf(markerText2, 13, "JumpPoint%u", jumpIndex);
-										smfInsertMetaEvent(smf, sseq2mid->track[trackIndex].offsetToAbsTime[newOffset], midiCh, 6, markerText2, 12);
-										smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 8);
-										jumpIndex++;
-									} else {
-										newOffset = getU3LitFrom(&sseq[curOffset]) + sseqOffsetBase;
-										curOffset += 3;
-										
-										offsetToJump = newOffset;
-										
-										if(offsetToJump >= sseq2mid->track[trackIndex].offsetToTop)
+									switch(sseq2mid->loopStyle)
+									{
+									case 0:
+										loopCount--;
+										if((loopCount > 0) && 
+												sseq2midCanRepeatLoopBody(&loopBody, offsetToJump, midiCh, sseq2mid->track[trackIndex].callDepth))
 										{
-											if(offsetToJump < curOffset)
-											{
-												switch(g_loopStyle)
-												{
-												case 0:
-													loopCount--;
-													break;
-												
-												case 1: 
-													if(!loopPointUsed)
-													{
-															smfInsertControl(smf, sseq2mid->track[trackIndex].offsetToAbsTime[offsetToJump], midiCh, midiCh, 0x74, 0);
-															smfInsertControl(smf, absTime, midiCh, midiCh, 0x75, 0);
-															loopPointUsed = true;
-													}
-													loopCount = 0;
-													break;
-										
-												case 2:
-													if(!loopPointUsed)
-													{
-															smfInsertMetaEvent(smf, sseq2mid->track[trackIndex].offsetToAbsTime[offsetToJump], midiCh, 6, "loopStart", 9);
-															smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, "loopEnd", 7);
-															loopPointUsed = true;
-													}
-													loopCount = 0;
-													break;
-												}
-											}
-											else
-											{
-												/* jump to forward */
-											}
+											/* the remaining repeats are copies of this pass */
+											absTime = sseq2midRepeatLoopBody(job, &loopBody, absTime, loopCount);
+											loopCount = 0;
 										}
-										else
+										break;
+									
+									case 1: 
+										if(!job->loopPoints->loopPointUsed)
+										{
+												smfInsertControl(smf, sseq2midGetAbsTimeAt(sseq2mid, trackIndex, offsetToJump), midiCh, midiCh, 0x74, 0);
+												smfInsertControl(smf, absTime, midiCh, midiCh, 0x75, 0);
+												job->loopPoints->loopPointUsed = true;
+										}
+										loopCount = 0;
+										break;
+							
+									case 2:
+										if(!job->loopPoints->loopPointUsed)
 										{
-											/* redirect */
+												smfInsertMetaEvent(smf, sseq2midGetAbsTimeAt(sseq2mid, trackIndex, offsetToJump), midiCh, 6, "loopStart", 9);
+												smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, "loopEnd", 7);
+												job->loopPoints->loopPointUsed = true;
 										}
+										loopCount = 0;
+										break;
 									}
-
-									//char markerText[14]; // "Jump:0x00FFFF"
-									//snprintf(markerText, 14, "Jump:0x%06X", newOffset);
-									//smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 13);
-									
-									sprintf(eventName, "Jump");
-									sprintf(eventDesc, "%08X", newOffset);
-									break;
 								}
-
-								case 0x95:
+								else
 								{
-									// TODO idea: Put a marker in the midi everytime there's a call command in the sseq; also put a marker for the return. Then, in midi2sseq, read these markers and recreate the call.
-									int newOffset;
+									/* jump to forward */
+								}
+							}
+							else
+							{
+								/* redirect */
+							}
+						}
 
-									newOffset = getU3LitFrom(&sseq[curOffset]) + sseqOffsetBase;
-									curOffset += 3;
+						//char markerText[14]; // "Jump:0x00FFFF"
+						//snprintf(markerText, 14, "Jump:0x%06X", newOffset);
+						//smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 13);
+						
+						break;
+					}
 
-									sseq2mid->track[trackIndex].offsetToReturn = curOffset;
-									offsetToJump = newOffset;
+					case 0x95:
+					{
+						// TODO idea: Put a marker in the midi everytime there's a call command in the sseq; also put a marker for the return. Then, in midi2sseq, read these markers and recreate the call.
+						Sseq2midTrackState* track = &sseq2mid->track[trackIndex];
+						const Sseq2midCallBlock* callBlock = NULL;
+						int newOffset;
 
-									sprintf(eventName, "Call");
-									sprintf(eventDesc, "%08X", newOffset);
-									break;
-								}
+						newOffset = instruction->param[0];
 
-								case 0xa0: /* Hanjuku Hero DS: NSE_45, New Mario Bros: BGM_AMB_CHIKA, Slime Morimori Dragon Quest 2: SE_187, SE_210, Advance Wars */
-								{
-									byte subStatusByte;
-									int16_t randMin;
-									int16_t randMax;
-
-									subStatusByte = getU1From(&sseq[curOffset]);
-									curOffset++;
-									randMin = getU2LitFrom(&sseq[curOffset]);
-									curOffset += 2;
-									randMax = getU2LitFrom(&sseq[curOffset]);
-									curOffset += 2;
-
-									char markerText[26]; // "Random:0xFF,-32767,-32767"
-									snprintf(markerText, 26, "Random:0x%02X,%d,%d", subStatusByte, randMin, randMax);
-									smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 25);
-
-									sprintf(eventName, "Random (%02X)", subStatusByte);
-									sprintf(eventDesc, "Min:%d Max:%d", randMin, randMax);
-									break;
-								}
+						if(track->callDepth >= SSEQ_MAX_CALL_DEPTH)
+						{
+							/* the player ignores a call that its stack can't hold */
+							callRecord[track->callDepth - 1].cacheable = false;
+							eventException = true;
+							break;
+						}
 
-								case 0xa1: /* New Mario Bros: BGM_AMB_SABAKU */
-								{
-									//// 0xA1. params: Sequence Command, u8. Replaces the last parameter of P1 with the value of variable P2
-									//byte subStatusByte;
-									//int varNumber;
+						if(copyEvents)
+						{
+							callBlock = sseq2midFindCallBlock(&callCache, newOffset);
+						}
+						if(callBlock && (callBlock->midiCh == midiCh) && (track->callDepth + callBlock->callDepth <= SSEQ_MAX_CALL_DEPTH))
+						{
+							/* the same subroutine again, copy its events instead of converting it */
+							if((callBlock->numEvents > 0) && 
+									!smfTrackRepeatEvents(smf->track[midiCh], callBlock->firstEvent, callBlock->numEvents, absTime - callBlock->startTime))
+							{
+								job->result = false;
+							}
+							absTime += callBlock->duration;
+							if((track->callDepth > 0) && (callRecord[track->callDepth - 1].callDepth < callBlock->callDepth + 1))
+							{
+								callRecord[track->callDepth - 1].callDepth = callBlock->callDepth + 1;
+							}
+							break;
+						}
+
+						callRecord[track->callDepth].offset = newOffset;
+						callRecord[track->callDepth].midiCh = midiCh;
+						callRecord[track->callDepth].firstEvent = sseq2midCountTrackEvents(smf, midiCh);
+						callRecord[track->callDepth].startTime = absTime;
+						callRecord[track->callDepth].callDepth = 1;
+						callRecord[track->callDepth].cacheable = copyEvents;
+						track->callStack[track->callDepth] = curOffset;
+						track->callDepth++;
+						offsetToJump = newOffset;
+
+						break;
+					}
+
+					case 0xa0: /* Hanjuku Hero DS: NSE_45, New Mario Bros: BGM_AMB_CHIKA, Slime Morimori Dragon Quest 2: SE_187, SE_210, Advance Wars */
+					{
+						byte subStatusByte;
+						int16_t randMin;
+						int16_t randMax;
+
+						subStatusByte = instruction->subCommand;
+						randMin = instruction->param[0];
+						randMax = instruction->param[1];
+
+						char markerText[26]; // "Random:0xFF,-32767,-32767"
+						snprintf(markerText, 26, "Random:0x%02X,%d,%d", subStatusByte, randMin, randMax);
+						smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 25);
+
+						break;
+					}
+
+					case 0xa1: /* New Mario Bros: BGM_AMB_SABAKU */
+					{
+						//// 0xA1. params: Sequence Command, u8. Replaces the last parameter of P1 with the value of variable P2
+						//byte subStatusByte;
+						//int varNumber;
                   //
-									//subStatusByte = getU1From(&sseq[curOffset]);
-									//curOffset++;
-									//if(subStatusByte >= 0xb0 && subStatusByte <= 0xbd) /* var */
-									//{
-									//	/* loveemu is a lazy person :P */
-									//	curOffset++;
-									//	varNumber = getU1From(&sseq[curOffset]);
-									//	curOffset++;
-									//}
-									//else
-									//{
-									//	varNumber = getU1From(&sseq[curOffset]);
-									//	curOffset++;
-									//}
+						//subStatusByte = getU1From(&sseq[curOffset]);
+						//curOffset++;
+						//if(subStatusByte >= 0xb0 && subStatusByte <= 0xbd) /* var */
+						//{
+						//	/* loveemu is a lazy person :P */
+						//	curOffset++;
+						//	varNumber = getU1From(&sseq[curOffset]);
+						//	curOffset++;
+						//}
+						//else
+						//{
+						//	varNumber = getU1From(&sseq[curOffset]);
+						//	curOffset++;
+						//}
                   //
-									//char markerText[16]; // "UseVar:0xFF,255"
-									//snprintf(markerText, 16, "UseVar:0x%02X,%u", subStatusByte, (uint8_t)varNumber);
-									//smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 15);
+						//char markerText[16]; // "UseVar:0xFF,255"
+						//snprintf(markerText, 16, "UseVar:0x%02X,%u", subStatusByte, (uint8_t)varNumber);
+						//smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 15);
                   //
-									//sprintf(eventName, "From Var (%02X)", subStatusByte);
-									//sprintf(eventDesc, "var %d", varNumber);
-									//break;
-									
-									char markerText[16];
-									readUseVar(sseq, &curOffset, markerText, eventName, eventDesc);
-									smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 15);
-									break;
-								}
+						//sprintf(eventName, "From Var (%02X)", subStatusByte);
+						//sprintf(eventDesc, "var %d", varNumber);
+						//break;
+						
+						char markerText[16];
+						formatUseVar(markerText, instruction->subCommand, instruction->param[0]);
+						smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 15);
+						break;
+					}
 
-								case 0xa2:
-								{
-									// params: Sequence Command. Executes P1 if the track's conditional flag is set
-									//byte subStatusByte;
-									//subStatusByte = getU1From(&sseq[curOffset]);
-									
-									//smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, "If (Not yet supported)", 22);
-																		
-									byte subStatusByte;
-									subStatusByte = getU1From(&sseq[curOffset]);
-									curOffset++;
-									
-									//printf("subStatusByte: 0x%02X\n", subStatusByte);
-									
-									char ifMarkerText[0xFF];
-									char subCommandMarkerText[0x7F];
-									if (subStatusByte == 0xA1) {
-										readUseVar(sseq, &curOffset, subCommandMarkerText, eventName, eventDesc);
-									} else if ((subStatusByte >= 0xB0 && subStatusByte <= 0xB6) || (subStatusByte >= 0xB8 && subStatusByte <= 0xBD)) {
-										readVarCom(sseq, &curOffset, subCommandMarkerText, statusByte, eventName, eventDesc);
-									} else if (subStatusByte < 0x80) { // note
-										int velocity;
-										int duration;
-										/*
-										const char* noteName[] = {
-											"C ", "C#", "D ", "D#", "E ", "F ", 
-											"F#", "G ", "G#", "A ", "A#", "B "
-										};
-										*/
-
-										velocity = getU1From(&sseq[curOffset]);
-										curOffset++;
-										duration = smfReadVarLength(&sseq[curOffset], sseqSize - curOffset);
-										curOffset += smfGetVarLengthSize(duration);
-										snprintf(subCommandMarkerText, 0x7F, "Note0x%02X:%d,%d", subStatusByte, velocity, duration);
-									} else if (subStatusByte == 0x94) { // duplicated code
-										int newOffset;
-										newOffset = getU3LitFrom(&sseq[curOffset]) + sseqOffsetBase;
-										curOffset += 3;
-										
-										char markerText[9]; // Jump:255
-										char markerText2[13]; // JumpPoint255
-										snprintf(markerText2, 13, "JumpPoint%u", jumpIndex);
-										smfInsertMetaEvent(smf, sseq2mid->track[trackIndex].offsetToAbsTime[newOffset], midiCh, 6, markerText2, 12);
-										snprintf(subCommandMarkerText, 0x7F, "Jump:%u", jumpIndex);
-										jumpIndex++;
-									} else {
-										int comIndex=0;
-										for (comIndex=0; comIndex < sseqComListLen; comIndex++){
-											if (sseqComList[comIndex].commandByte == subStatusByte){
-												break;
-											}
-										}
-										strcpy(subCommandMarkerText, sseqComList[comIndex].commandName);
-										strcat(subCommandMarkerText, ":");
-										//printf("subCommandMarkerText: %s\n", subCommandMarkerText);
-										// void readParamOfType(char* outputText, int sseqParamType, byte* sseq, size_t* curOffset, size_t* sseqOffsetBase, size_t* sseqSize);
-										if (sseqComList[comIndex].param1 != NOPARAM){
-											char param1valText[10]; 
-											readParamOfType(param1valText, sseqComList[comIndex].param1, sseq, &curOffset, &sseqOffsetBase, &sseqSize);
-											//printf("param1valText: %s\n", param1valText);
-											strcat(subCommandMarkerText, param1valText);
-											
-											if (sseqComList[comIndex].param2 != NOPARAM){
-												strcat(subCommandMarkerText, ",");
-												char param2valText[10]; 
-												readParamOfType(param2valText, sseqComList[comIndex].param1, sseq, &curOffset, &sseqOffsetBase, &sseqSize);
-												strcat(subCommandMarkerText, param2valText);
-												
-												if (sseqComList[comIndex].param3 != NOPARAM){
-													strcat(subCommandMarkerText, ",");
-													char param3valText[10]; 
-													readParamOfType(param3valText, sseqComList[comIndex].param1, sseq, &curOffset, &sseqOffsetBase, &sseqSize);
-													strcat(subCommandMarkerText, param3valText);
-												}
-											}
-										}
-										//printf("subCommandMarkerText: %s\n", subCommandMarkerText);
-									}
-									snprintf(ifMarkerText, 0xFF, "If:%s", subCommandMarkerText);
-									//printf("ifMarkerText: %s\n", ifMarkerText);
-									smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, ifMarkerText, strlen(ifMarkerText));
+					case 0xa2:
+					{
+						// params: Sequence Command. Executes P1 if the track's conditional flag is set
+						//byte subStatusByte;
+						//subStatusByte = getU1From(&sseq[curOffset]);
+						
+						//smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, "If (Not yet supported)", 22);
+															
+						byte subStatusByte;
+						subStatusByte = instruction->subCommand;
+						
+						//printf("subStatusByte: 0x%02X\n", subStatusByte);
+						
+						char ifMarkerText[0xFF];
+						char subCommandMarkerText[0x7F];
+						if (subStatusByte == 0xA1) {
+							formatUseVar(subCommandMarkerText, instruction->param[0], instruction->param[1]);
+						} else if ((subStatusByte >= 0xB0 && subStatusByte <= 0xB6) || (subStatusByte >= 0xB8 && subStatusByte <= 0xBD)) {
+							formatVarCom(subCommandMarkerText, subStatusByte, instruction->param[0], instruction->param[1]);
+						} else if (subStatusByte < 0x80) { // note
+							int velocity;
+							int duration;
+							/*
+							const char* noteName[] = {
+								"C ", "C#", "D ", "D#", "E ", "F ", 
+								"F#", "G ", "G#", "A ", "A#", "B "
+							};
+							*/
+
+							velocity = instruction->param[0];
+							duration = instruction->param[1];
+							snprintf(subCommandMarkerText, 0x7F, "Note0x%02X:%d,%d", subStatusByte, velocity, duration);
+						} else if (subStatusByte == 0x94) { // duplicated code
+							int newOffset;
+							newOffset = instruction->param[0];
+							
+							char markerText[9]; // Jump:255
+							char markerText2[13]; // JumpPoint255
+							snprintf(markerText2, 13, "JumpPoint%u", jumpIndex);
+							smfInsertMetaEvent(smf, sseq2midGetAbsTimeAt(sseq2mid, trackIndex, newOffset), midiCh, 6, markerText2, 12);
+							snprintf(subCommandMarkerText, 0x7F, "Jump:%u", jumpIndex);
+							jumpIndex++;
+						} else {
+							formatComMarker(subCommandMarkerText, sseqFindCom(subStatusByte), instruction->param);
+							//printf("subCommandMarkerText: %s\n", subCommandMarkerText);
+						}
+						snprintf(ifMarkerText, 0xFF, "If:%s", subCommandMarkerText);
+						//printf("ifMarkerText: %s\n", ifMarkerText);
+						smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, ifMarkerText, strlen(ifMarkerText));
 
-									sprintf(eventName, "If");
-									sprintf(eventDesc, ""); // TODO: add description here.
-									break;
-								}
+						break;
+					}
 
-								case 0xb0: /* Children of Mana: SEQ_BGM001 */
-								case 0xb1: /* Advance Wars - Dual Strike: SE_TAGPT_COUNT01 */
-								case 0xb2:
-								case 0xb3:
-								case 0xb4:
-								case 0xb5:
-								case 0xb6: /* Mario Kart DS: 76th sequence */
-								case 0xb8: /* Tottoko Hamutaro: MUS_ENDROOL, Nintendogs */
-								case 0xb9:
-								case 0xba:
-								case 0xbb:
-								case 0xbc:
-								case 0xbd:
-								{
-									/*
-									uint8_t varNumber;
-									int16_t val;
-									const char* varMethodName[] = {
-										"=", "+=", "-=", "*=", "/=", "[Shift]", "[Rand]", "", 
-										"==", ">=", ">", "<=", "<", "!="
-									};
-
-									varNumber = getU1From(&sseq[curOffset]);
-									curOffset++;
-									val = getU2LitFrom(&sseq[curOffset]);
-									curOffset += 2;
-
-									char markerText[23]; // "Var:255,[Shift],-32767"
-									snprintf(markerText, 23, "Var:%u,%s,%d", varNumber, varMethodName[statusByte - 0xb0], val);
-									smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 22);
-
-									sprintf(eventName, "Variable %s", varMethodName[statusByte - 0xb0]);
-									sprintf(eventDesc, "var %u : %d", varNumber, val);
-									break;
-									*/
-									
-									// void readVarCom(byte** sseqPointer, size_t* curOffset, char** outputString, byte statusByte, char** eventName, char** eventDesc)
-									//printf("curOffset before: %d\n", curOffset);
-									char markerText[23];
-									readVarCom(sseq, &curOffset, markerText, statusByte, eventName, eventDesc);
-									//printf("markerText: %s\n", markerText);
-									smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 22);
-									//printf("curOffset after: %d\n", curOffset);
-									//sprintf(eventName, "Var Command");
-									//sprintf(eventDesc, "%s", markerText); 
-									break;
-								}
+					case 0xb0: /* Children of Mana: SEQ_BGM001 */
+					case 0xb1: /* Advance Wars - Dual Strike: SE_TAGPT_COUNT01 */
+					case 0xb2:
+					case 0xb3:
+					case 0xb4:
+					case 0xb5:
+					case 0xb6: /* Mario Kart DS: 76th sequence */
+					case 0xb8: /* Tottoko Hamutaro: MUS_ENDROOL, Nintendogs */
+					case 0xb9:
+					case 0xba:
+					case 0xbb:
+					case 0xbc:
+					case 0xbd:
+					{
+						/*
+						uint8_t varNumber;
+						int16_t val;
+						const char* varMethodName[] = {
+							"=", "+=", "-=", "*=", "/=", "[Shift]", "[Rand]", "", 
+							"==", ">=", ">", "<=", "<", "!="
+						};
+
+						varNumber = getU1From(&sseq[curOffset]);
+						curOffset++;
+						val = getU2LitFrom(&sseq[curOffset]);
+						curOffset += 2;
+
+						char markerText[23]; // "Var:255,[Shift],-32767"
+						snprintf(markerText, 23, "Var:%u,%s,%d", varNumber, varMethodName[statusByte - 0xb0], val);
+						smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 22);
+
+						break;
+						*/
+						
+						// void readVarCom(byte** sseqPointer, size_t* curOffset, char** outputString, byte statusByte, char** eventName, char** eventDesc)
+						//printf("curOffset before: %d\n", curOffset);
+						char markerText[23];
+						formatVarCom(markerText, statusByte, instruction->param[0], instruction->param[1]);
+						//printf("markerText: %s\n", markerText);
+						smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 22);
+						//printf("curOffset after: %d\n", curOffset);
+						//sprintf(eventName, "Var Command");
+						//sprintf(eventDesc, "%s", markerText); 
+						break;
+					}
 
-								case 0xc0:
-								{
-									int pan;
+					case 0xc2: /* Dawn of Sorrow: SDL_BGM_BOSS1_ */
+					{
+						int vol;
 
-									pan = getU1From(&sseq[curOffset]);
-									curOffset++;
+						vol = instruction->param[0];
 
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_PANPOT, pan);
+						smfInsertMasterVolume(smf, absTime+stackedEventTimeSpacer, 0, midiCh, vol); // a bug in Reaper might cause the sysex to not appear when the tracks of the midi file are expanded into multiple Reaper tracks.
 
-									sprintf(eventName, "Pan");
-									//sprintf(eventDesc, "%d", pan - 64);
-									sprintf(eventDesc, "%d", pan); // printing it like this more closely matches midi and sseq
-									break;
-								}
+						// sprintf(eventName, "Player Volume"); // according to Gota7's sequence.md. Likely changes the volume of the master track
+						break;
+					}
 
-								case 0xc1:
-								{
-									int vol;
+					case 0xc3: /* Puyo Pop Fever 2: BGM00 */
+					{
+						int transpose;
+
+						transpose = instruction->param[0]; // I think this is equal to the number of semitones moved. in ex song in vgmtrans: C30C is read as "12", 12 semitones (an octave) makes sense. -12 is probably down 12 semitones.
+
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_RPNM, 0);
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_RPNL, 2);
+						//smfInsertControl(smf, absTime, midiCh, midiCh, SMF_CONTROL_DATAENTRYM, 64 + transpose);
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_DATAENTRYM, transpose + 32/*0x20*/);
+						// "Coarse tuning: The coarse tuning RPNs use only the coarse data entry message to tune, with 0x20 representing central tuning of A = 440 Hz and with increments of whole semitones (e.g., 0x21 would be a whole semitone displacement up)."
+						// https://www.recordingblogs.com/wiki/midi-registered-parameter-number-rpn
+
+						break;
+					}
+
+					case 0xc4:
+					{
+						// signed value. C400 is normal pitch (midi pitch 8192 / +0)
+						// WARNING: midi pitch bend is a 14-bit integer, while sseq pitch bend is a 8-bit signed integer. Conversion cannot be completely lossless.
+						int bend;
+
+						bend = instruction->param[0] * 64;
+
+						smfInsertPitchBend(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, bend);
+
+						break;
+					}
+
+					case 0xc5:
+					{
+						int range;
+
+						range = instruction->param[0]; // number of semitones. TODO: find out if negative values are valid by injecting sequence data into a DS game.
+
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_RPNM, 0);
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_RPNL, 0);
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_DATAENTRYM, range);
+
+						break;
+					}
+
+					case 0xc7: /* Dawn of Sorrow: SDL_BGM_ARR1_ */
+					{
+						// sequence.md describes this as "note wait mode": "Is off by default, but if on waits for a note to finish before continuing". "waiting for a note to finish" effectively means that the music/channel is monophonic (only one note can play at a time) instead of polyphonic (multiple notes can play at the same time)
+						
+						
+						/*
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, instruction->param[0] ? SMF_CONTROL_MONO : SMF_CONTROL_POLY, 0);
+						sseq2mid->track[trackIndex].noteWait = instruction->param[0] ? true : false;
+						*/
+						// I have yet to find a song that sets notewait to on, and Poly On events in Reaper are difficult (They're not selected when using ctrl+a)
+
+						break;
+					}
+
+					case 0xcc: /* Children of Mana: SEQ_BGM001 */
+					{
+						int type;
+
+						type = instruction->param[0];
+						
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, /*cc*/22, type); // In the future, I may use cc110 and cc111 like gba_mus_ripper, but that would require writing/forking an nds sound bank ripper to add modulators to the sf2.
+						break;
+					}
+
+					case 0xd4: /* Dawn of Sorrow: SDL_BGM_WIND_ */
+					{
+
+						loopStartCount = instruction->param[0];
+
+						if (sseq2mid->loopStyle == 3) {
+							char markerText[14]; // loopStart:255
+							snprintf(markerText, 14, "loopStart:%d", loopStartCount);
+							smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 13);
+						} else {
+							loopStartOffset = curOffset;
+							if(loopStartCount == 0)
+							{
+									loopStartCount = -1;
+									if(!job->loopPoints->loopStartPointUsed)
+									{
+											switch(sseq2mid->loopStyle)
+											{
+											case 1:
+													smfInsertControl(smf, absTime, midiCh, midiCh, 0x74, 0);
+													break;
+											case 2:
+													smfInsertMetaEvent(smf, absTime, midiCh, 6, "loopStart", 9);
+													break;
+											}
+											job->loopPoints->loopStartPointUsed = true;
+									}
+							}
+							if(copyEvents)
+							{
+								sseq2midStartLoopBody(&loopBody, curOffset, smf, midiCh, absTime, sseq2mid->track[trackIndex].callDepth);
+							}
+						}
+						
+						
+						/*
+						char markerText[14]; // loopStart:255
+						snprintf(markerText, 14, "loopStart:%u", loopStartCount);
+						smfInsertMetaEvent(smf, absTime, midiCh, 6, markerText, 13);
+						*/
+
+						eventLogValue = loopStartCount;
+						break;
+					}
 
-									vol = getU1From(&sseq[curOffset]);
-									curOffset++;
+					case 0xe0: /* Children of Mana: SEQ_BGM001 */
+					{
+						// ex song has E04600 (little endian) which should be 70 in decimal.
+						int amount;
+
+						amount = instruction->param[0];
+						
+						if ((int16_t)amount <= 0x7F && (int16_t)amount >= 0) {
+							smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, /*cc*/26, (int8_t)amount); // same as gba_mus_ripper
+							// It seems like high values are valid, but impractical.
+						} else {
+							char markerText[16]; // ModDelay:-32767
+							snprintf(markerText, 16, "ModDelay:%d", (int16_t)amount);
+							smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 15);
+						}
+						
+						break;
+					}
 
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_VOLUME, vol);
+					case 0xe1:
+					{
+						int bpm;
 
-									// sprintf(eventName, "Volume");
-									sprintf(eventName, "Track Volume"); // according to Gota7's sequence.md
-									sprintf(eventDesc, "%d", vol);
-									break;
-								}
+						bpm = instruction->param[0];
 
-								case 0xc2: /* Dawn of Sorrow: SDL_BGM_BOSS1_ */
-								{
-									int vol;
+						smfInsertTempoBPM(smf, absTime, midiCh, bpm);
 
-									vol = getU1From(&sseq[curOffset]);
-									curOffset++;
+						break;
+					}
 
-									smfInsertMasterVolume(smf, absTime+stackedEventTimeSpacer, 0, midiCh, vol); // a bug in Reaper might cause the sysex to not appear when the tracks of the midi file are expanded into multiple Reaper tracks.
+					case 0xe3: /* Hippatte! Puzzle Bobble: SEQ_1pbgm03 */
+					{
+						// Gota's sequence.md lists this as 0xE2, which seems to be a typo.
+						int amount;
 
-									sprintf(eventName, "Master Volume");
-									// sprintf(eventName, "Player Volume"); // according to Gota7's sequence.md. Likely changes the volume of the master track
-									sprintf(eventDesc, "%d", vol);
-									break;
-								}
+						amount = instruction->param[0]; // TODO: research possible values for amount by injecting sequence data into a DS game. negative values likely set the sweep pitch below the default; or maybe negative values are invalid?
+						// ex song contains "E3 C0 FF" and "E3 00 FA". Both of these are far outside the valid midi cc range of 0-127. I have implemented per-track text markers containing the original value so events like these can be converted losslessly.
 
-								case 0xc3: /* Puyo Pop Fever 2: BGM00 */
-								{
-									int transpose;
+						//smfInsertControl(smf, absTime, midiCh, midiCh, SMF_CONTROL_VIBRATODELAY, amount);
+						smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, 9, (((int32_t)amount + 0x7FFF) / (float)0xFFFE) * (int16_t)127 ); // If I ever make an NDS sound bank ripper that converts sound banks to sf2 files with modulators, this CC will be used as input for a modulator that controls vibrato. For now, it does nothing; only the below marker has any effect, and only when the midi is run through midi2sseq.
+						char markerText[18]; // "SweepPitch:-32767"
+						snprintf(markerText, 18, "SweepPitch:%d", amount);
+						smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 17);
 
-									transpose = getS1From(&sseq[curOffset]); // I think this is equal to the number of semitones moved. in ex song in vgmtrans: C30C is read as "12", 12 semitones (an octave) makes sense. -12 is probably down 12 semitones.
-									curOffset++;
+						break;
+					}
 
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_RPNM, 0);
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_RPNL, 2);
-									//smfInsertControl(smf, absTime, midiCh, midiCh, SMF_CONTROL_DATAENTRYM, 64 + transpose);
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_DATAENTRYM, transpose + 32/*0x20*/);
-									// "Coarse tuning: The coarse tuning RPNs use only the coarse data entry message to tune, with 0x20 representing central tuning of A = 440 Hz and with increments of whole semitones (e.g., 0x21 would be a whole semitone displacement up)."
-									// https://www.recordingblogs.com/wiki/midi-registered-parameter-number-rpn
+					case 0xfc: /* Dawn of Sorrow: SDL_BGM_WIND_ */
+					{
+						
+						if (sseq2mid->loopStyle == 3) {
+							smfInsertMetaEvent(smf, absTime, midiCh, 6, "loopEnd", 7);
+						} else {
+							if(loopStartCount > 0)
+							{
+									if(sseq2midCanRepeatLoopBody(&loopBody, loopStartOffset, midiCh, sseq2mid->track[trackIndex].callDepth))
+									{
+											/* copies of this pass for the remaining count, then go on */
+											absTime = sseq2midRepeatLoopBody(job, &loopBody, absTime, loopStartCount);
+											loopStartCount = 0;
+									}
+									else
+									{
+											loopStartCount--;
+											curOffset = loopStartOffset;
+									}
+							}
+							if(loopStartCount == -1)
+							{
+									switch(sseq2mid->loopStyle)
+									{
+									case 0:
+											loopCount--;
+											curOffset = loopStartOffset;
+											if((loopCount > 0) && 
+													sseq2midCanRepeatLoopBody(&loopBody, loopStartOffset, midiCh, sseq2mid->track[trackIndex].callDepth))
+											{
+													absTime = sseq2midRepeatLoopBody(job, &loopBody, absTime, loopCount);
+													loopCount = 0;
+											}
+											break;
+									case 1:
+											if(!job->loopPoints->loopEndPointUsed)
+											{
+													smfInsertControl(smf, absTime, midiCh, midiCh, 0x75, 0);
+													loopCount = 0;
+													job->loopPoints->loopEndPointUsed = true;
+											}
+											break;
+									case 2:
+											if(!job->loopPoints->loopEndPointUsed)
+											{
+													smfInsertMetaEvent(smf, absTime, midiCh, 6, "loopEnd", 7);
+													loopCount = 0;
+													job->loopPoints->loopEndPointUsed = true;
+											}
+											break;
+									}
+							}
 
-									sprintf(eventName, "Transpose");
-									sprintf(eventDesc, "%d", transpose);
-									break;
-								}
+							/* the loop count is not the same on the next pass of an outer loop */
+							loopBody.repeatable = false;
+						}
+						
+						break;
+					}
 
-								case 0xc4:
-								{
-									// signed value. C400 is normal pitch (midi pitch 8192 / +0)
-									// WARNING: midi pitch bend is a 14-bit integer, while sseq pitch bend is a 8-bit signed integer. Conversion cannot be completely lossless.
-									int bend;
+					case 0xfd:
+					{
+						Sseq2midTrackState* track = &sseq2mid->track[trackIndex];
 
-									bend = getS1From(&sseq[curOffset]) * 64;
-									curOffset++;
+						if(track->callDepth > 0)
+						{
+							Sseq2midCallBlock* callBlock;
 
-									smfInsertPitchBend(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, bend);
+							track->callDepth--;
+							offsetToJump = track->callStack[track->callDepth];
 
-									sprintf(eventName, "Pitch Bend");
-									sprintf(eventDesc, "%d", bend);
-									break;
-								}
+							/* the first call of a subroutine is kept for the later ones */
+							callBlock = &callRecord[track->callDepth];
+							if(callBlock->cacheable && !sseq2midFindCallBlock(&callCache, callBlock->offset))
+							{
+								callBlock->numEvents = sseq2midCountTrackEvents(smf, callBlock->midiCh) - callBlock->firstEvent;
+								callBlock->duration = absTime - callBlock->startTime;
+								sseq2midAddCallBlock(&callCache, callBlock);
+							}
+							if(track->callDepth > 0)
+							{
+								Sseq2midCallBlock* callerBlock = &callRecord[track->callDepth - 1];
 
-								case 0xc5:
+								if(!callBlock->cacheable)
 								{
-									int range;
-
-									range = getU1From(&sseq[curOffset]); // number of semitones. TODO: find out if negative values are valid by injecting sequence data into a DS game.
-									curOffset++;
-
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_RPNM, 0);
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_RPNL, 0);
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_DATAENTRYM, range);
-
-									sprintf(eventName, "Pitch Bend Range");
-									sprintf(eventDesc, "%d", range);
-									break;
+									callerBlock->cacheable = false;
 								}
-
-								case 0xc6: /* Children of Mana: SEQ_BGM000 */
+								if(callerBlock->callDepth < callBlock->callDepth + 1)
 								{
-									int priority;
-
-									priority = getU1From(&sseq[curOffset]);
-									curOffset++;
-									
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, 14, priority);
-
-									sprintf(eventName, "Priority");
-									sprintf(eventDesc, "%d", priority);
-									break;
+									callerBlock->callDepth = callBlock->callDepth + 1;
 								}
+							}
+						}
+						else
+						{
+							offsetToJump = SSEQ_INVALID_OFFSET;
+							loopCount = 0;
+							eventException = true;
+							job->result = false;
+						}
 
-								case 0xc7: /* Dawn of Sorrow: SDL_BGM_ARR1_ */
-								{
-									// sequence.md describes this as "note wait mode": "Is off by default, but if on waits for a note to finish before continuing". "waiting for a note to finish" effectively means that the music/channel is monophonic (only one note can play at a time) instead of polyphonic (multiple notes can play at the same time)
-									
-									
-									int flg;
+						eventLogValue = (int) offsetToJump;
+						break;
+					}
 
-									flg = getU1From(&sseq[curOffset]);
-									curOffset++;
+					case 0xfe:
+					{
+						// "Allocate Tracks: Bitflag P1 for how to allocate tracks"
+						int flag;
+						unsigned int bit;
 
-									/*
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, flg ? SMF_CONTROL_MONO : SMF_CONTROL_POLY, 0);
-									sseq2mid->track[trackIndex].noteWait = flg ? true : false;
-									*/
-									// I have yet to find a song that sets notewait to on, and Poly On events in Reaper are difficult (They're not selected when using ctrl+a)
+						flag = instruction->param[0];
 
-									sprintf(eventName, "Mono/Poly");
-									sprintf(eventDesc, "%s (%d)", flg ? "Mono" : "Poly", flg);
-									break;
-								}
+						if(sseq2mid->modifyChOrder)
+						{
+							int sseqCh;
+							int midiCh = 0;
 
-								case 0xc8: /* Hanjuku Hero DS: NSE_42 */
+							/* padding tracks, if necessary */
+							bit = 1;
+							for(sseqCh = 0; sseqCh < SSEQ_MAX_TRACK; sseqCh++)
+							{
+								if(flag & bit)
 								{
-									int flg;
-
-									flg = getU1From(&sseq[curOffset]);
-									curOffset++;
-
-									// "If on, notes don't end and new notes just change the pitch and velocity of the playing note"
-									char markerText[8]; // Tie:Off
-									snprintf(markerText, 8, "Tie:%s", flg ? "On" : "Off");
-									smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 7);
-
-									sprintf(eventName, "Tie");
-									sprintf(eventDesc, "%s (%d)", flg ? "On" : "Off", flg);
-									break;
+									sseq2mid->chOrder[sseqCh] = sseqMidiChOrder[midiCh];
+									midiCh++;
 								}
-
-								case 0xc9: /* Hanjuku Hero DS: NSE_50 */
+								bit = bit << 1;
+							}
+							bit = 1;
+							for(sseqCh = 0; sseqCh < SSEQ_MAX_TRACK; sseqCh++)
+							{
+								if(!(flag & bit))
 								{
-									int key;
-
-									key = getU1From(&sseq[curOffset]);
-									curOffset++;
+									sseq2mid->chOrder[sseqCh] = sseqMidiChOrder[midiCh];
+									midiCh++;
+								}
+								bit = bit << 1;
+							}
+						}
+						break;
+					}
 
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_PORTAMENTOCTRL, key);
+					case 0xff:
+					{
+						loopCount = 0;
+						break;
+					}
 
-									sprintf(eventName, "Portamento Control");
-									sprintf(eventDesc, "%d", key);
-									break;
-								}
+#if 0
+					case 0xfa: /* WarioWare Touched! */ // TODO: research. This is not in Gota's SSEQ docs.
+#endif
 
-								case 0xca: /* Dawn of Sorrow: SDL_BGM_ARR1_ */
-								{
-									int amount;
+					default:
+					{
+						/* commands that just convert to a CC or a text marker */
+						const sseqCom* com = sseqFindCom(statusByte);
 
-									amount = getU1From(&sseq[curOffset]);
-									curOffset++;
+						if(com && (com->convToMidiEvType == CC || com->convToMidiEvType == TEXTMARKER))
+						{
+							int value = instruction->param[0];
 
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_MODULATION, amount);
+							if(com->convToMidiEvType == CC)
+							{
+								smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, com->CCnum, 
+									(com->param1 == BOOLPARAM) ? (value ? 127 : 0) : value);
+							}
+							else
+							{
+								char markerText[64] = { 0 };
+								size_t markerSize = (statusByte == 0xc8) ? 7 : 12; // "Tie:Off", "PrintVar:255"
 
-									sprintf(eventName, "Modulation Depth");
-									sprintf(eventDesc, "%d", amount);
-									break;
-								}
+								formatComMarker(markerText, com, instruction->param);
+								smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, markerSize);
+							}
+						}
+						else
+						{
+							loopCount = 0;
+							eventException = true;
+							eventExceptionOffset = curOffset;
+							job->result = false;
+						}
+						break;
+					}
+					}
+				}
+				if (sseq2mid->spacer) {
+					uint8_t spacerIncBlacklist[] = {0x80, 0x93, 0x95, 0xd4, 0xe1, 0xfc, 0xfd, 0xfe}; // list of commands that should not increment stackedEventTimeSpacer.
+					bool eventInBlacklist=false;
+					int spacerIncBlacklistLength = sizeof(spacerIncBlacklist) / sizeof(spacerIncBlacklist[0]);
+					for (int i=0; i<spacerIncBlacklistLength; i++) {
+						if (statusByte == spacerIncBlacklist[i]) {
+							eventInBlacklist=true;
+							break;
+						}
+					}
+					//printf("eventInBlacklist: %d\n", eventInBlacklist);
+					if (!(eventException==true || eventInBlacklist==true)) stackedEventTimeSpacer++;
+					//printf("stackedEventTimeSpacer: %d\n", stackedEventTimeSpacer);
+					//printf("absTime: %d\n", absTime);
+				}
+				prevStatusByte = statusByte;
+			}
+			else
+			{
+				loopCount = 0;
+			}
 
-								case 0xcb: /* Dawn of Sorrow: SDL_BGM_ARR1_ */
-								{
-									int amount;
+			/* names and descriptions are only formatted when someone reads them */
+			if(eventException || sseq2mid->logProc)
+			{
+				Sseq2midEventLog eventLog;
+				char eventName[64];
+				char eventDesc[64];
+
+				eventLog.offset = eventOffset;
+				eventLog.instruction = instruction;
+				eventLog.value = eventLogValue;
+				sseq2midFormatEventLog(sseq2mid, &eventLog, eventName, eventDesc);
+				if(eventException)
+				{
+					char warningMsg[192];
 
-									amount = getU1From(&sseq[curOffset]);
-									curOffset++;
+					snprintf(warningMsg, sizeof(warningMsg), "warning: exception [%s - %s]. Offset: 0x%lX.\n", eventName, eventDesc, (unsigned long) eventExceptionOffset);
+					sseq2midPutWarning(sseq2mid, warningMsg);
+					strcat(eventDesc, " (!)");
+				}
+				sseq2midPutLogLine(sseq2mid, eventOffset, instruction ? instruction->length : 0, eventName, eventDesc);
+			}
+			if(offsetToJump != SSEQ_INVALID_OFFSET)
+			{
+				curOffset = offsetToJump;
+			}
+			sseq2mid->track[trackIndex].absTime = absTime;
+			sseq2mid->track[trackIndex].curOffset = curOffset;
+			sseq2mid->track[trackIndex].loopCount = loopCount;
+		} while(loopCount > 0);
 
-									//smfInsertControl(smf, absTime, midiCh, midiCh, SMF_CONTROL_VIBRATORATE, 64 + amount / 2);
-									// SMF_CONTROL_VIBRATORATE is cc76, which is Sound Controller 7: "Generic – Some manufacturers may use to further shave their sounds."
-									// https://nickfever.com/music/midi-cc-list
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, /*cc*/21 /*same cc as gba_mus_ripper*/, amount); // other uint8 values, like 0xCA mod depth, seem to stay in between 0 and 127. This is also less lossy.
+		if(sseq2mid->noReverb)
+		{
+			smfInsertControl(smf, 0, midiCh, midiCh, SMF_CONTROL_REVERB, 0);
+		}
+		smfSetEndTimingOfTrack(smf, midiCh, sseq2mid->track[trackIndex].absTime); // on new super mario bros, BGM_AMB_CHIKA, with stackedEventTimeSpacer, the note gets cut off.
+		sseq2midPutLog(sseq2mid, "\n");
+	}
+	free(callCache.block);
+}
 
-									sprintf(eventName, "Modulation Speed");
-									sprintf(eventDesc, "%d", amount);
-									break;
-								}
+/* find the subroutine block of a call target */
+const Sseq2midCallBlock* sseq2midFindCallBlock(const Sseq2midCallCache* callCache, size_t offset)
+{
+	size_t blockIndex;
 
-								case 0xcc: /* Children of Mana: SEQ_BGM001 */
-								{
-									int type;
-									char* typeStr[] = { "Pitch", "Volume", "Pan" };
+	for(blockIndex = 0; blockIndex < callCache->numBlocks; blockIndex++)
+	{
+		if(callCache->block[blockIndex].offset == offset)
+		{
+			return &callCache->block[blockIndex];
+		}
+	}
+	return NULL;
+}
 
-									type = getU1From(&sseq[curOffset]);
-									curOffset++;
-									
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, /*cc*/22, type); // In the future, I may use cc110 and cc111 like gba_mus_ripper, but that would require writing/forking an nds sound bank ripper to add modulators to the sf2.
+/* keep a subroutine block, a failure only means that it will be converted again */
+bool sseq2midAddCallBlock(Sseq2midCallCache* callCache, const Sseq2midCallBlock* callBlock)
+{
+	if(callCache->numBlocks == callCache->maxBlocks)
+	{
+		size_t newMaxBlocks = callCache->maxBlocks ? (callCache->maxBlocks * 2) : 16;
+		Sseq2midCallBlock* newBlock = (Sseq2midCallBlock*) realloc(callCache->block, sizeof(Sseq2midCallBlock) * newMaxBlocks);
 
-									sprintf(eventName, "Modulation Type");
-									sprintf(eventDesc, "%s", typeStr[type]);
-									break;
-								}
+		if(!newBlock)
+		{
+			return false;
+		}
+		callCache->block = newBlock;
+		callCache->maxBlocks = newMaxBlocks;
+	}
+	callCache->block[callCache->numBlocks] = *callBlock;
+	callCache->numBlocks++;
+	return true;
+}
 
-								case 0xcd: /* Phoenix Wright: BGM021 */
-								{
-									int amount;
+/* start a loop body at offset, from the current state of the track */
+void sseq2midStartLoopBody(Sseq2midLoopBody* loopBody, size_t offset, Smf* smf, int midiCh, int absTime, int callDepth)
+{
+	loopBody->offset = offset;
+	loopBody->midiCh = midiCh;
+	loopBody->firstEvent = sseq2midCountTrackEvents(smf, midiCh);
+	loopBody->startTime = absTime;
+	loopBody->callDepth = callDepth;
+	loopBody->repeatable = true;
+}
 
-									amount = getU1From(&sseq[curOffset]);
-									curOffset++;
+/* check if a loop back to offset can copy the pass that was just converted */
+bool sseq2midCanRepeatLoopBody(const Sseq2midLoopBody* loopBody, size_t offset, int midiCh, int callDepth)
+{
+	return loopBody->repeatable && (loopBody->offset == offset) && 
+		(loopBody->midiCh == midiCh) && (loopBody->callDepth == callDepth);
+}
 
-									//smfInsertControl(smf, absTime, midiCh, midiCh, SMF_CONTROL_VIBRATODEPTH, 64 + amount / 2); // SMF_CONTROL_VIBRATODEPTH is also a generic sound controller.
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, /*cc*/3, amount);
+/* put the events of a loop body again for each repeat, as converting it again would do.
+   returns the time after the last repeat */
+int sseq2midRepeatLoopBody(Sseq2midTrackJob* job, const Sseq2midLoopBody* loopBody, int absTime, int numRepeats)
+{
+	int loopLength = absTime - loopBody->startTime;
+	size_t numEvents = sseq2midCountTrackEvents(job->smf, loopBody->midiCh) - loopBody->firstEvent;
+	int repeatIndex;
 
-									sprintf(eventName, "Modulation Range"); // TODO: how is this different from mod depth?
-									sprintf(eventDesc, "%d", amount);
-									break;
-								}
+	for(repeatIndex = 1; repeatIndex <= numRepeats; repeatIndex++)
+	{
+		if((numEvents > 0) && 
+				!smfTrackRepeatEvents(job->smf->track[loopBody->midiCh], loopBody->firstEvent, numEvents, loopLength * repeatIndex))
+		{
+			job->result = false;
+			break;
+		}
+	}
 
-								case 0xce: /* Dawn of Sorrow: SDL_BGM_ARR1_ */
-								{
-									// "Portamento Switch: Enters or cancels portamento mode"
-									int flg; // TODO: research possible values of flg for midi2sseq conversion.
+	/* the top of the body was reached last by the last repeat */
+	sseq2midSetAbsTimeAt(job->sseq2mid, job->trackIndex, loopBody->offset, absTime + loopLength * (numRepeats - 1));
+	return absTime + loopLength * numRepeats;
+}
 
-									flg = getU1From(&sseq[curOffset]);
-									curOffset++;
+/* number of events in a midi track so far */
+size_t sseq2midCountTrackEvents(Smf* smf, int midiCh)
+{
+	return (midiCh < smf->numTracks) ? smf->track[midiCh]->numEvents : 0;
+}
 
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_PORTAMENTO /*TODO: change name to PORTAMENTOSWITCH*/, !flg ? 0 : 127);
+#ifndef SSEQ2MID_NO_THREADS
+/* jobs shared by the workers of a conversion */
+typedef struct TagSseq2midTrackPool
+{
+  Sseq2midTrackJob job[SSEQ_MAX_TRACK];
+  Sseq2midLoopPoints loopPoints[SSEQ_MAX_TRACK];
+  int numJobs;
+  int nextJob;
+  pthread_mutex_t mutex;
+} Sseq2midTrackPool;
+
+/* worker of the track pool, takes jobs until none is left */
+void* sseq2midTrackWorker(void* userData)
+{
+	Sseq2midTrackPool* pool = (Sseq2midTrackPool*) userData;
 
-									sprintf(eventName, "Portamento");
-									sprintf(eventDesc, "%s (%d)", flg ? "On" : "Off", flg);
-									break;
-								}
+	for(;;)
+	{
+		Sseq2midTrackJob* job = NULL;
 
-								case 0xcf: /* Bomberman: SEQ_AREA04 */
-								{
-									int time;
+		pthread_mutex_lock(&pool->mutex);
+		if(pool->nextJob < pool->numJobs)
+		{
+			job = &pool->job[pool->nextJob];
+			pool->nextJob++;
+		}
+		pthread_mutex_unlock(&pool->mutex);
 
-									time = getU1From(&sseq[curOffset]);
-									curOffset++;
+		if(!job)
+		{
+			break;
+		}
+		sseq2midConvertTrack(job);
+	}
+	return NULL;
+}
+#endif /* !SSEQ2MID_NO_THREADS */
 
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_PORTAMENTOTIME, time);
+/* convert the tracks opened by track 0 on a thread pool, each into a smf of its own.
+   returns false when they have to be converted one by one instead */
+bool sseq2midConvertTracksInParallel(Sseq2mid* sseq2mid, size_t sseqOffsetBase, bool* result)
+{
+#ifndef SSEQ2MID_NO_THREADS
+	Sseq2midTrackPool pool;
+	Sseq2midTrackState savedTrack[SSEQ_MAX_TRACK];
+	pthread_t thread[SSEQ_MAX_TRACK];
+	int numThreads = 0;
+	long numCpus;
+	bool parallelResult = true;
+	int jobIndex;
+	int trackIndex;
+
+	/* the log is put in order of tracks, loop styles 1 and 2 mark the first loop in order of tracks */
+	if(!sseq2mid->parallelTracks || sseq2mid->logProc || (sseq2mid->loopStyle == 1) || (sseq2mid->loopStyle == 2))
+	{
+		return false;
+	}
 
-									sprintf(eventName, "Portamento Time");
-									sprintf(eventDesc, "%d", time);
-									break;
-								}
+	pool.numJobs = 0;
+	pool.nextJob = 0;
+	for(trackIndex = 1; trackIndex < SSEQ_MAX_TRACK; trackIndex++)
+	{
+		if(sseq2mid->track[trackIndex].loopCount > 0)
+		{
+			Smf* trackSmf = smfCreate();
 
-								case 0xd0: /* Dawn of Sorrow: SDL_BGM_WIND_ */
-								{
-									int amount;
+			if(!trackSmf)
+			{
+				parallelResult = false;
+				break;
+			}
+			smfSetTimebase(trackSmf, sseq2mid->smf->timebase);
+			smfSetRunningStatus(trackSmf, sseq2mid->smf->runningStatus);
+			pool.loopPoints[pool.numJobs].loopPointUsed = false;
+			pool.loopPoints[pool.numJobs].loopStartPointUsed = false;
+			pool.loopPoints[pool.numJobs].loopEndPointUsed = false;
+			sseq2midInitTrackJob(&pool.job[pool.numJobs], sseq2mid, trackIndex, trackSmf, sseqOffsetBase, &pool.loopPoints[pool.numJobs]);
+			pool.job[pool.numJobs].isolated = true;
+			pool.numJobs++;
+		}
+	}
 
-									amount = getU1From(&sseq[curOffset]); 
-									curOffset++;
-#if 0
-									smfInsertControl(smf, absTime, midiCh, midiCh, SMF_CONTROL_ATTACKTIME, 64 + amount / 2);
-#endif
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_ATTACKTIME, amount); // This may also require a modulator, but the semantic meaning of the midicc matches up.
-									sprintf(eventName, "Attack Rate"); 
-									sprintf(eventDesc, "%d", amount);
-									break;
-								}
+	/* a single track is not worth a thread */
+	if(parallelResult && (pool.numJobs >= 2))
+	{
+		memcpy(savedTrack, sseq2mid->track, sizeof(savedTrack));
+		pthread_mutex_init(&pool.mutex, NULL);
 
-								case 0xd1: /* Dawn of Sorrow: SDL_BGM_WIND_ */
-								{
-									int amount;
+		/* this thread works too, so a failure to start threads only slows it down */
+		numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+		while((numThreads + 1 < pool.numJobs) && (numThreads + 1 < numCpus))
+		{
+			if(pthread_create(&thread[numThreads], NULL, sseq2midTrackWorker, &pool) != 0)
+			{
+				break;
+			}
+			numThreads++;
+		}
+		sseq2midTrackWorker(&pool);
+		while(numThreads > 0)
+		{
+			numThreads--;
+			pthread_join(thread[numThreads], NULL);
+		}
+		pthread_mutex_destroy(&pool.mutex);
 
-									amount = getU1From(&sseq[curOffset]); 
-									curOffset++;
-#if 0
-									smfInsertControl(smf, absTime, midiCh, midiCh, SMF_CONTROL_DECAYTIME, 64 + amount / 2);
-#endif
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_DECAYTIME, amount); // This is a generic sound controller. I'll leave it as a generic sound controller since attack and release are also sound controllers.
-									sprintf(eventName, "Decay Rate");
-									sprintf(eventDesc, "%d", amount);
-									break;
-								}
+		for(jobIndex = 0; jobIndex < pool.numJobs; jobIndex++)
+		{
+			if(pool.job[jobIndex].needsSerial)
+			{
+				parallelResult = false;
+			}
+		}
 
-								case 0xd2: /* Dawn of Sorrow: SDL_BGM_WIND_ */
-								{
-									int amount;
+		if(parallelResult)
+		{
+			for(jobIndex = 0; jobIndex < pool.numJobs; jobIndex++)
+			{
+				Sseq2midTrackJob* job = &pool.job[jobIndex];
+				int midiCh = sseq2midSseqChToMidiCh(sseq2mid, job->trackIndex);
 
-									amount = getU1From(&sseq[curOffset]); 
-									curOffset++;
-									
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, /*cc*/76, amount); // This is a generic sound controller
+				if((midiCh >= job->smf->numTracks) 
+						|| !smfAttachTrack(sseq2mid->smf, midiCh, job->smf->track[midiCh]))
+				{
+					*result = false;
+				}
+				if(!job->result)
+				{
+					*result = false;
+				}
+			}
+		}
+		else
+		{
+			/* start over, from the state that track 0 left */
+			memcpy(sseq2mid->track, savedTrack, sizeof(savedTrack));
+			if(sseq2mid->numJumpTargets)
+			{
+				memset(&sseq2mid->jumpTargetAbsTime[sseq2mid->numJumpTargets], 0,
+					sizeof(int) * sseq2mid->numJumpTargets * (SSEQ_MAX_TRACK - 1));
+			}
+		}
+	}
+	else
+	{
+		parallelResult = false;
+	}
 
-									sprintf(eventName, "Sustain Rate");
-									sprintf(eventDesc, "%d", amount);
-									break;
-								}
+	for(jobIndex = 0; jobIndex < pool.numJobs; jobIndex++)
+	{
+		smfDelete(pool.job[jobIndex].smf);
+	}
+	return parallelResult;
+#else
+	return false;
+#endif /* !SSEQ2MID_NO_THREADS */
+}
 
-								case 0xd3: /* Dawn of Sorrow: SDL_BGM_WIND_ */
-								{
-									int amount;
+#define SSEQ_MIN_SIZE	 0x1d
 
-									amount = getU1From(&sseq[curOffset]);
-									curOffset++;
-#if 0
-									smfInsertControl(smf, absTime, midiCh, midiCh, SMF_CONTROL_RELEASETIME, 64 + amount / 2);
-#endif
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_RELEASETIME, amount);
-									sprintf(eventName, "Release Rate");
-									sprintf(eventDesc, "%d", amount);
-									break;
-								}
+/* sseq2mid conversion main, enjoy my dirty code :P */
+bool sseq2midConvert(Sseq2mid* sseq2mid)
+{
+	bool result = false;
+	char strForLog[64];
+	Sseq2midLoopPoints loopPoints = { false, false, false };
+	Sseq2midTrackJob job;
 
-								case 0xd4: /* Dawn of Sorrow: SDL_BGM_WIND_ */
-								{
+	if(sseq2mid)
+	{
+		const byte* sseq = sseq2mid->sseq;
+		size_t sseqSize = sseq2mid->sseqSize;
+		Smf* smf = sseq2mid->smf;
 
-									loopStartCount = getU1From(&sseq[curOffset]);
-									curOffset++;
+		if(sseqIsSseq(sseq, sseqSize))
+		{
+			int trackIndex;
+			int midiCh;
+			size_t sseqOffsetBase;
+			
+			sseqOffsetBase = (size_t) getU4LitFrom(&sseq[0x18]);
 
-									if (g_loopStyle == 3) {
-										char markerText[14]; // loopStart:255
-										snprintf(markerText, 14, "loopStart:%d", loopStartCount);
-										smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 13);
-									} else {
-										loopStartOffset = curOffset;
-										if(loopStartCount == 0)
-										{
-												loopStartCount = -1;
-												if(!loopStartPointUsed)
-												{
-														switch(g_loopStyle)
-														{
-														case 1:
-																smfInsertControl(smf, absTime, midiCh, midiCh, 0x74, 0);
-																break;
-														case 2:
-																smfInsertMetaEvent(smf, absTime, midiCh, 6, "loopStart", 9);
-																break;
-														}
-														loopStartPointUsed = true;
-												}
-										}
-									}
-									
-									
-									/*
-									char markerText[14]; // loopStart:255
-									snprintf(markerText, 14, "loopStart:%u", loopStartCount);
-									smfInsertMetaEvent(smf, absTime, midiCh, 6, markerText, 13);
-									*/
-
-									sprintf(eventName, "Loop Start");
-									sprintf(eventDesc, "%d", loopStartCount);
-									break;
-								}
+			if(sseq2mid->logProc)
+			{
+				/* put SSEQ header info */
+				sseq2midPutLogLine(sseq2mid, 0x00, 4, "Signature", "SSEQ");
+				sseq2midPutLogLine(sseq2mid, 0x04, 2, "", "Unknown");
+				sseq2midPutLogLine(sseq2mid, 0x06, 2, "", "Unknown");
+				sprintf(strForLog, "%u", getU4LitFrom(&sseq[0x08]));
+				sseq2midPutLogLine(sseq2mid, 0x08, 4, "SSEQ file size", strForLog);
+				sseq2midPutLogLine(sseq2mid, 0x0c, 2, "", "Unknown");
+				sseq2midPutLogLine(sseq2mid, 0x0e, 2, "", "Unknown");
+				sseq2midPutLog(sseq2mid, "\n");
+
+				/* put DATA chunk header */
+				sseq2midPutLogLine(sseq2mid, 0x10, 4, "Signature", "DATA");
+				sprintf(strForLog, "%u", getU4LitFrom(&sseq[0x14]));
+				sseq2midPutLogLine(sseq2mid, 0x14, 4, "DATA chunk size", strForLog);
+				sprintf(strForLog, "%08X", (unsigned int) sseqOffsetBase);
+				sseq2midPutLogLine(sseq2mid, 0x18, 4, "Offset Base", strForLog);
+				sseq2midPutLog(sseq2mid, "\n");
+			}
 
-								case 0xd5:
-								{
-									// "Volume 2: Sets track volume 2 to P1"
-									int expression;
+			/* index jump targets */
+			if(!sseq2midIndexJumpTargets(sseq2mid, sseqOffsetBase))
+			{
+				return false;
+			}
 
-									expression = getU1From(&sseq[curOffset]);
-									curOffset++;
+			/* decode commands */
+			if(!sseq2midDecode(sseq2mid, sseqOffsetBase))
+			{
+				return false;
+			}
 
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, SMF_CONTROL_EXPRESSION, expression);
+			/* initialize channel order */
+			for(midiCh = 0; midiCh < SSEQ_MAX_TRACK; midiCh++)
+			{
+				sseq2mid->chOrder[midiCh] = sseq2mid->modifyChOrder ? sseqMidiChOrder[midiCh] : midiCh;
+			}
 
-									sprintf(eventName, "Expression");
-									sprintf(eventDesc, "%d", expression);
-									break;
-								}
+			/* initialize track settings */
+			sseq2midInitTracks(sseq2mid);
 
-								case 0xd6:
-								{
-									int varNumber;
+			/* initialize midi */
+#if 0
+			smfInsertGM1SystemOn(smf, 0, 0, 0);
+#endif
 
-									varNumber = getU1From(&sseq[curOffset]);
-									curOffset++;
+			/* convert each track, track 0 first as it opens the others */
+			sseq2midInitTrackJob(&job, sseq2mid, 0, smf, sseqOffsetBase, &loopPoints);
+			sseq2midConvertTrack(&job);
+			result = job.result;
+			if(!sseq2midConvertTracksInParallel(sseq2mid, sseqOffsetBase, &result))
+			{
+				for(trackIndex = 1; trackIndex < SSEQ_MAX_TRACK; trackIndex++)
+				{
+					sseq2midInitTrackJob(&job, sseq2mid, trackIndex, smf, sseqOffsetBase, &loopPoints);
+					sseq2midConvertTrack(&job);
+					if(!job.result)
+					{
+						result = false;
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		sseq2midPutLog(sseq2mid, "is not valid SSEQ\n");
+	}
+	return result;
+}
 
-									/* TEST */
-									char markerText[13];
-									snprintf(markerText, 13, "PrintVar:%u", (uint8_t)varNumber);
-									smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 12);
+/* check sseq signatures */
+bool sseqIsSseq(const byte* sseq, size_t sseqSize)
+{
+	return (sseqSize >= SSEQ_MIN_SIZE) && 
+		(sseq[0x00] == 'S') && (sseq[0x01] == 'S') && (sseq[0x02] == 'E') && (sseq[0x03] == 'Q') && 
+		(sseq[0x10] == 'D') && (sseq[0x11] == 'A') && (sseq[0x12] == 'T') && (sseq[0x13] == 'A');
+}
 
-									sprintf(eventName, "Print Variable");
-									sprintf(eventDesc, "%d", varNumber);
-									break;
-								}
+/* put track 0 at the top of sequence, others are inactive until opened */
+void sseq2midInitTracks(Sseq2mid* sseq2mid)
+{
+	int trackIndex;
+
+	sseq2mid->track[0].loopCount = sseq2mid->loopCount;
+	sseq2mid->track[0].absTime = 0; 
+	sseq2mid->track[0].noteWait = false;
+	sseq2mid->track[0].offsetToTop = 0x1c;
+	sseq2mid->track[0].callDepth = 0;
+	sseq2mid->track[0].curOffset = sseq2mid->track[0].offsetToTop;
+	for(trackIndex = 1; trackIndex < SSEQ_MAX_TRACK; trackIndex++)
+	{
+		sseq2mid->track[trackIndex].loopCount = 0;	/* inactive */
+		sseq2mid->track[trackIndex].noteWait = false;
+	}
+}
 
-								case 0xe0: /* Children of Mana: SEQ_BGM001 */
-								{
-									// ex song has E04600 (little endian) which should be 70 in decimal.
-									int amount;
+/* get length, loop points and tempo changes of the song without making midi.
+   tracks are run with loop style 0 and the loop count of sseq2mid, only for their timing;
+   the results are those that sseq2midConvert would put into midi. info is freed by sseq2midFreeInfo */
+bool sseq2midQueryInfo(Sseq2mid* sseq2mid, Sseq2midInfo* info)
+{
+	bool result = true;
+	size_t sseqOffsetBase;
+	int trackIndex;
+
+	memset(info, 0, sizeof(Sseq2midInfo));
+	info->loopStart = -1;
+	info->loopEnd = -1;
+	if(!sseq2mid || !sseqIsSseq(sseq2mid->sseq, sseq2mid->sseqSize))
+	{
+		return false;
+	}
 
-									amount = getU2LitFrom(&sseq[curOffset]);
-									curOffset += 2;
-									
-									if ((int16_t)amount <= 0x7F && (int16_t)amount >= 0) {
-										smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, /*cc*/26, (int8_t)amount); // same as gba_mus_ripper
-										// It seems like high values are valid, but impractical.
-									} else {
-										char markerText[16]; // ModDelay:-32767
-										snprintf(markerText, 16, "ModDelay:%d", (int16_t)amount);
-										smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 15);
-									}
-									
-									sprintf(eventName, "Modulation Delay");
-									sprintf(eventDesc, "%d", amount);
-									break;
-								}
+	sseqOffsetBase = (size_t) getU4LitFrom(&sseq2mid->sseq[0x18]);
+	if(!sseq2midIndexJumpTargets(sseq2mid, sseqOffsetBase))
+	{
+		return false;
+	}
 
-								case 0xe1:
-								{
-									int bpm;
+	/* most commands run just once here, decoding them on the way is cheaper than ahead */
+	sseq2midFreeInstructions(sseq2mid);
 
-									bpm = getU2LitFrom(&sseq[curOffset]);
-									curOffset += 2;
+	/* in the same order as conversion, track 0 opens the others */
+	sseq2midInitTracks(sseq2mid);
+	for(trackIndex = 0; trackIndex < SSEQ_MAX_TRACK; trackIndex++)
+	{
+		if(!sseq2midQueryTrack(sseq2mid, trackIndex, sseqOffsetBase, info))
+		{
+			result = false;
+		}
+	}
 
-									smfInsertTempoBPM(smf, absTime, midiCh, bpm);
+	/* tracks at the same time keep their order, as tempo events of midi do */
+	if(info->numTempos > 1)
+	{
+		size_t tempoIndex;
 
-									sprintf(eventName, "Tempo");
-									sprintf(eventDesc, "%d", bpm);
-									break;
-								}
+		for(tempoIndex = 1; tempoIndex < info->numTempos; tempoIndex++)
+		{
+			Sseq2midTempo tempo = info->tempo[tempoIndex];
+			size_t insertIndex = tempoIndex;
 
-								case 0xe3: /* Hippatte! Puzzle Bobble: SEQ_1pbgm03 */
-								{
-									// Gota's sequence.md lists this as 0xE2, which seems to be a typo.
-									int amount;
-
-									amount = getS2LitFrom(&sseq[curOffset]); // TODO: research possible values for amount by injecting sequence data into a DS game. negative values likely set the sweep pitch below the default; or maybe negative values are invalid?
-									// ex song contains "E3 C0 FF" and "E3 00 FA". Both of these are far outside the valid midi cc range of 0-127. I have implemented per-track text markers containing the original value so events like these can be converted losslessly.
-									curOffset += 2;
-
-									//smfInsertControl(smf, absTime, midiCh, midiCh, SMF_CONTROL_VIBRATODELAY, amount);
-									smfInsertControl(smf, absTime+stackedEventTimeSpacer, midiCh, midiCh, 9, (((int32_t)amount + 0x7FFF) / (float)0xFFFE) * (int16_t)127 ); // If I ever make an NDS sound bank ripper that converts sound banks to sf2 files with modulators, this CC will be used as input for a modulator that controls vibrato. For now, it does nothing; only the below marker has any effect, and only when the midi is run through midi2sseq.
-									char markerText[18]; // "SweepPitch:-32767"
-									snprintf(markerText, 18, "SweepPitch:%d", amount);
-									smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 17);
-
-									sprintf(eventName, "Sweep Pitch");
-									sprintf(eventDesc, "%d", amount);
-									break;
-								}
+			while((insertIndex > 0) && (info->tempo[insertIndex - 1].absTime > tempo.absTime))
+			{
+				info->tempo[insertIndex] = info->tempo[insertIndex - 1];
+				insertIndex--;
+			}
+			info->tempo[insertIndex] = tempo;
+		}
+	}
 
-								case 0xfc: /* Dawn of Sorrow: SDL_BGM_WIND_ */
-								{
-									
-									if (g_loopStyle == 3) {
-										smfInsertMetaEvent(smf, absTime, midiCh, 6, "loopEnd", 7);
-									} else {
-										if(loopStartCount > 0)
-										{
-												loopStartCount--;
-												curOffset = loopStartOffset;
-										}
-										if(loopStartCount == -1)
-										{
-												switch(g_loopStyle)
-												{
-												case 0:
-														loopCount--;
-														curOffset = loopStartOffset;
-														break;
-												case 1:
-														if(!loopEndPointUsed)
-														{
-																smfInsertControl(smf, absTime, midiCh, midiCh, 0x75, 0);
-																loopCount = 0;
-																loopEndPointUsed = true;
-														}
-														break;
-												case 2:
-														if(!loopEndPointUsed)
-														{
-																smfInsertMetaEvent(smf, absTime, midiCh, 6, "loopEnd", 7);
-																loopCount = 0;
-																loopEndPointUsed = true;
-														}
-														break;
-												}
-										}
-									}
-									
-									sprintf(eventName, "Loop End");
-									sprintf(eventDesc, "");
-									break;
-								}
+	info->seconds = sseq2midTicksToSeconds(info, info->length);
+	if(info->loopEnd >= 0)
+	{
+		info->loopStartSeconds = sseq2midTicksToSeconds(info, info->loopStart);
+		info->loopEndSeconds = sseq2midTicksToSeconds(info, info->loopEnd);
+	}
+	return result;
+}
 
-								case 0xfd:
-								{
-									offsetToJump = sseq2mid->track[trackIndex].offsetToReturn;
-									sseq2mid->track[trackIndex].offsetToReturn = SSEQ_INVALID_OFFSET; /* to avoid eternal loop */
+/* release tempo changes of info */
+void sseq2midFreeInfo(Sseq2midInfo* info)
+{
+	free(info->tempo);
+	info->tempo = NULL;
+	info->numTempos = 0;
+	info->maxTempos = 0;
+}
 
-									if(offsetToJump == SSEQ_INVALID_OFFSET)
-									{
-										loopCount = 0;
-										eventException = true;
-										result = false;
-									}
+/* seconds at ticks along the tempo changes of info, 120 bpm until the first one */
+double sseq2midTicksToSeconds(const Sseq2midInfo* info, int ticks)
+{
+	double seconds = 0.0;
+	int bpm = 120;
+	int prevTime = 0;
+	size_t tempoIndex;
 
-									sprintf(eventName, "Return");
-									sprintf(eventDesc, "%08X", offsetToJump);
-									break;
-								}
+	for(tempoIndex = 0; (tempoIndex < info->numTempos) && (info->tempo[tempoIndex].absTime < ticks); tempoIndex++)
+	{
+		if(bpm > 0)
+		{
+			seconds += (double) (info->tempo[tempoIndex].absTime - prevTime) * 60.0 / (bpm * SSEQ_TIMEBASE);
+		}
+		prevTime = info->tempo[tempoIndex].absTime;
+		bpm = info->tempo[tempoIndex].bpm;
+	}
+	if(bpm > 0)
+	{
+		seconds += (double) (ticks - prevTime) * 60.0 / (bpm * SSEQ_TIMEBASE);
+	}
+	return seconds;
+}
 
-								case 0xfe:
-								{
-									// "Allocate Tracks: Bitflag P1 for how to allocate tracks"
-									int flag;
-									unsigned int bit;
+/* run a track from its current state for its timing only, as sseq2midConvertTrack does with loop style 0 */
+bool sseq2midQueryTrack(Sseq2mid* sseq2mid, int trackIndex, size_t sseqOffsetBase, Sseq2midInfo* info)
+{
+	Sseq2midTrackState* track = &sseq2mid->track[trackIndex];
+	size_t sseqSize = sseq2mid->sseqSize;
+	int loopCount = track->loopCount;
+	int loopStartCount = 0;
+	size_t loopStartOffset = 0;
+	int loopStartTime = 0;
+	int absTime = track->absTime;
+	int noteEndTime = 0;
+	size_t curOffset = track->curOffset;
+	size_t instructionHint = 0;
+	SseqInstruction scratchInstruction;
+	bool result = true;
+
+	while(loopCount > 0)
+	{
+		const SseqInstruction* instruction;
+		size_t offsetToJump = SSEQ_INVALID_OFFSET;
 
-									flag = getU2LitFrom(&sseq[curOffset]);
-									curOffset += 2;
+		if(curOffset >= sseqSize)
+		{
+			break;
+		}
 
-									if(sseq2mid->modifyChOrder)
-									{
-										int sseqCh;
-										int midiCh = 0;
+		sseq2midSetAbsTimeAt(sseq2mid, trackIndex, curOffset, absTime);
+		instruction = sseq2midGetInstruction(sseq2mid, curOffset, sseqOffsetBase, &instructionHint, &scratchInstruction);
+		if(!instruction)
+		{
+			break;
+		}
+		curOffset += instruction->length;
 
-										/* padding tracks, if necessary */
-										bit = 1;
-										for(sseqCh = 0; sseqCh < SSEQ_MAX_TRACK; sseqCh++)
-										{
-											if(flag & bit)
-											{
-												sseq2mid->chOrder[sseqCh] = midiChOrder[midiCh];
-												midiCh++;
-											}
-											bit = bit << 1;
-										}
-										bit = 1;
-										for(sseqCh = 0; sseqCh < SSEQ_MAX_TRACK; sseqCh++)
-										{
-											if(!(flag & bit))
-											{
-												sseq2mid->chOrder[sseqCh] = midiChOrder[midiCh];
-												midiCh++;
-											}
-											bit = bit << 1;
-										}
-									}
+		if(instruction->command < 0x80)
+		{
+			/* a note may sound past the end of its track, which midi ends after it; a silent one is left out of midi */
+			if((instruction->param[0] > 0) && (absTime + instruction->param[1] > noteEndTime))
+			{
+				noteEndTime = absTime + instruction->param[1];
+			}
+			if(track->noteWait)
+			{
+				absTime += instruction->param[1];
+			}
+		}
+		else
+		{
+			switch(instruction->command)
+			{
+			case 0x80:
+				absTime += instruction->param[0];
+				break;
 
-									sprintf(eventName, "Signify Multi Track");
-									strcpy(eventDesc, "");
-									for(bit = 1; bit < 0x10000; bit = bit << 1)
-									{
-										strcat(eventDesc, (flag & bit) ? "*" : "-");
-									}
-									break;
-								}
+			case 0x93:
+			{
+				int newTrackIndex = instruction->param[0];
 
-								case 0xff:
-								{
-									loopCount = 0;
-									sprintf(eventName, "End of Track");
-									sprintf(eventDesc, "");
-									break;
-								}
+				if(newTrackIndex < SSEQ_MAX_TRACK)
+				{
+					sseq2mid->track[newTrackIndex].loopCount = loopCount;
+					sseq2mid->track[newTrackIndex].absTime = absTime;
+					sseq2mid->track[newTrackIndex].offsetToTop = instruction->param[1];
+					sseq2mid->track[newTrackIndex].callDepth = 0;
+					sseq2mid->track[newTrackIndex].curOffset = instruction->param[1];
+				}
+				break;
+			}
 
-#if 0
-								case 0xfa: /* WarioWare Touched! */ // TODO: research. This is not in Gota's SSEQ docs.
-#endif
+			case 0x94:
+				offsetToJump = instruction->param[0];
+				if((offsetToJump >= track->offsetToTop) && (offsetToJump < curOffset))
+				{
+					/* the first loop of the song gives loop points */
+					if(info->loopEnd < 0)
+					{
+						info->loopStart = sseq2midGetAbsTimeAt(sseq2mid, trackIndex, offsetToJump);
+						info->loopEnd = absTime;
+					}
+					loopCount--;
+				}
+				break;
 
-								default:
-									loopCount = 0;
-									eventException = true;
-									eventExceptionOffset = curOffset;
-									result = false;
-									break;
-								}
-							}
-							if (g_spacer) {
-								uint8_t spacerIncBlacklist[] = {0x80, 0x93, 0x95, 0xd4, 0xe1, 0xfc, 0xfd, 0xfe}; // list of commands that should not increment stackedEventTimeSpacer.
-								bool eventInBlacklist=false;
-								int spacerIncBlacklistLength = sizeof(spacerIncBlacklist) / sizeof(spacerIncBlacklist[0]);
-								for (int i=0; i<spacerIncBlacklistLength; i++) {
-									if (statusByte == spacerIncBlacklist[i]) {
-										eventInBlacklist=true;
-										break;
-									}
-								}
-								//printf("eventInBlacklist: %d\n", eventInBlacklist);
-								if (!(eventException==true || eventInBlacklist==true)) stackedEventTimeSpacer++;
-								//printf("stackedEventTimeSpacer: %d\n", stackedEventTimeSpacer);
-								//printf("absTime: %d\n", absTime);
-							}
-							prevStatusByte = statusByte;
-						}
-						else
-						{
-							loopCount = 0;
-						}
+			case 0x95:
+				/* the player ignores a call that its stack can't hold */
+				if(track->callDepth < SSEQ_MAX_CALL_DEPTH)
+				{
+					track->callStack[track->callDepth] = curOffset;
+					track->callDepth++;
+					offsetToJump = instruction->param[0];
+				}
+				break;
 
-						if(eventException)
-						{
-							fprintf(stderr, "warning: exception [%s - %s]. Offset: 0x%lX.\n", eventName, eventDesc, eventExceptionOffset);
-							strcat(eventDesc, " (!)");
-						}
+			case 0xd4:
+				loopStartCount = instruction->param[0];
+				loopStartOffset = curOffset;
+				loopStartTime = absTime;
+				if(loopStartCount == 0)
+				{
+					loopStartCount = -1;
+				}
+				break;
 
-						sseq2midPutLogLine(sseq2mid, eventOffset, curOffset - eventOffset, eventName, eventDesc);
-						if(offsetToJump != SSEQ_INVALID_OFFSET)
-						{
-							curOffset = offsetToJump;
-						}
-						sseq2mid->track[trackIndex].absTime = absTime;
-						sseq2mid->track[trackIndex].curOffset = curOffset;
-						sseq2mid->track[trackIndex].loopCount = loopCount;
-					} while(loopCount > 0);
+			case 0xe1:
+				if(!sseq2midAddTempo(info, absTime, instruction->param[0]))
+				{
+					result = false;
+				}
+				break;
 
-					if(sseq2mid->noReverb)
+			case 0xfc:
+				if(loopStartCount > 0)
+				{
+					loopStartCount--;
+					curOffset = loopStartOffset;
+				}
+				if(loopStartCount == -1)
+				{
+					if(info->loopEnd < 0)
 					{
-						smfInsertControl(smf, 0, midiCh, midiCh, SMF_CONTROL_REVERB, 0);
+						info->loopStart = loopStartTime;
+						info->loopEnd = absTime;
 					}
-					smfSetEndTimingOfTrack(smf, midiCh, sseq2mid->track[midiCh].absTime); // on new super mario bros, BGM_AMB_CHIKA, with stackedEventTimeSpacer, the note gets cut off.
-					sseq2midPutLog(sseq2mid, "\n");
+					loopCount--;
+					curOffset = loopStartOffset;
+				}
+				break;
+
+			case 0xfd:
+				if(track->callDepth > 0)
+				{
+					track->callDepth--;
+					offsetToJump = track->callStack[track->callDepth];
+				}
+				else
+				{
+					loopCount = 0;
+					result = false;
+				}
+				break;
+
+			case 0xff:
+				loopCount = 0;
+				break;
+
+			default:
+				/* unknown command stops the track */
+				if(!sseqIsKnownCommand(instruction->command))
+				{
+					loopCount = 0;
+					result = false;
 				}
+				break;
 			}
 		}
+
+		if(offsetToJump != SSEQ_INVALID_OFFSET)
+		{
+			curOffset = offsetToJump;
+		}
 	}
-	else
+
+	track->absTime = absTime;
+	track->curOffset = curOffset;
+	track->loopCount = 0;
+	if(absTime > info->length)
 	{
-		sseq2midPutLog(sseq2mid, "is not valid SSEQ\n");
+		info->length = absTime;
+	}
+	if(noteEndTime > info->length)
+	{
+		info->length = noteEndTime;
 	}
 	return result;
 }
 
+/* add a tempo change to info */
+bool sseq2midAddTempo(Sseq2midInfo* info, int absTime, int bpm)
+{
+	if(info->numTempos == info->maxTempos)
+	{
+		size_t newMaxTempos = info->maxTempos ? (info->maxTempos * 2) : 16;
+		Sseq2midTempo* newTempos = (Sseq2midTempo*) realloc(info->tempo, newMaxTempos * sizeof(Sseq2midTempo));
+
+		if(!newTempos)
+		{
+			return false;
+		}
+		info->tempo = newTempos;
+		info->maxTempos = newMaxTempos;
+	}
+	info->tempo[info->numTempos].absTime = absTime;
+	info->tempo[info->numTempos].bpm = bpm;
+	info->numTempos++;
+	return true;
+}
+
 /* output standard midi to memory from sseq2mid object */
 size_t sseq2midWriteMidi(Sseq2mid* sseq2mid, byte* buffer, size_t bufferSize)
 {
 	return smfWrite(sseq2mid->smf, buffer, bufferSize);
 }
 
+/* output standard midi to sink procedure from sseq2mid object */
+size_t sseq2midWriteMidiToSink(Sseq2mid* sseq2mid, SmfWriteProc* writeProc, void* userData)
+{
+	return smfWriteToSink(sseq2mid->smf, writeProc, userData);
+}
+
 /* output standard midi file from sseq2mid object */
 size_t sseq2midWriteMidiFile(Sseq2mid* sseq2mid, const char* filename)
 {
 	return smfWriteFile(sseq2mid->smf, filename);
 }
 
-/* set log message procedure */
-void sseq2midSetLogProc(Sseq2mid* sseq2mid, Sseq2midLogProc* logProc)
+/* set log message procedure, userData is passed to it as is */
+void sseq2midSetLogProc(Sseq2mid* sseq2mid, Sseq2midLogProc* logProc, void* userData)
 {
 	if(sseq2mid && logProc)
 	{
 		sseq2mid->logProc = logProc;
+		sseq2mid->logUserData = userData;
+	}
+}
+
+/* set warning message procedure, warnings go to stderr without it */
+void sseq2midSetWarningProc(Sseq2mid* sseq2mid, Sseq2midLogProc* warningProc, void* userData)
+{
+	if(sseq2mid && warningProc)
+	{
+		sseq2mid->warningProc = warningProc;
+		sseq2mid->warningUserData = userData;
+	}
+}
+
+/* set style of loop conversion (0: expand, 1: CC 116/117, 2: loopStart/loopEnd markers, 3: jump markers) */
+int sseq2midSetLoopStyle(Sseq2mid* sseq2mid, int loopStyle)
+{
+	int oldLoopStyle = 0;
+
+	if(sseq2mid)
+	{
+		oldLoopStyle = sseq2mid->loopStyle;
+		sseq2mid->loopStyle = loopStyle;
+	}
+	return oldLoopStyle;
+}
+
+/* set spacer mode, which puts simultaneous events apart by a tick to keep their order */
+bool sseq2midUseSpacer(Sseq2mid* sseq2mid, bool spacer)
+{
+	bool oldSpacer = false;
+
+	if(sseq2mid)
+	{
+		oldSpacer = sseq2mid->spacer;
+		sseq2mid->spacer = spacer;
 	}
+	return oldSpacer;
 }
 
 /* set reverb mode */
@@ -1573,6 +3787,31 @@ bool sseq2midNoReverb(Sseq2mid* sseq2mid, bool noReverb)
 	return oldNoReverb;
 }
 
+/* set parallel conversion of tracks */
+bool sseq2midParallelTracks(Sseq2mid* sseq2mid, bool parallelTracks)
+{
+	bool oldParallelTracks = false;
+
+	if(sseq2mid)
+	{
+		oldParallelTracks = sseq2mid->parallelTracks;
+		sseq2mid->parallelTracks = parallelTracks;
+	}
+	return oldParallelTracks;
+}
+
+/* set running status mode of midi output */
+bool sseq2midUseRunningStatus(Sseq2mid* sseq2mid, bool runningStatus)
+{
+	bool oldRunningStatus = false;
+
+	if(sseq2mid)
+	{
+		oldRunningStatus = smfSetRunningStatus(sseq2mid->smf, runningStatus);
+	}
+	return oldRunningStatus;
+}
+
 /* set sequence loop count */
 int sseq2midSetLoopCount(Sseq2mid* sseq2mid, int loopCount)
 {
@@ -1591,192 +3830,99 @@ int sseq2midSetLoopCount(Sseq2mid* sseq2mid, int loopCount)
 
 
 /* get signed byte */
-int getS1From(byte* data)
+int getS1From(const byte* data)
 {
 	int val = data[0];
 	return (val & 0x80) ? -(signed) (0xFF-val+1) : val;
 }
 
 /* get signed 2 bytes as little endian */
-int getS2LitFrom(byte* data)
+int getS2LitFrom(const byte* data)
 {
 	int val = data[0] | (data[1] << 8);
 	return (val & 0x8000) ? -(signed) (0xFFFF-val+1) : val;
 }
 
 /* get signed 3 bytes as little endian */
-int getS3LitFrom(byte* data)
+int getS3LitFrom(const byte* data)
 {
 	int val = data[0] | (data[1] << 8) | (data[2] << 16);
 	return (val & 0x800000) ? -(signed) (0xFFFFFF-val+1) : val;
 }
 
 /* get signed 4 bytes as little endian */
-int getS4LitFrom(byte* data)
+int getS4LitFrom(const byte* data)
 {
 	int val = data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24);
 	return (val & 0x80000000) ? -(signed) (0xFFFFFFFF-val+1) : val;
 }
 
 /* get unsigned byte */
-unsigned int getU1From(byte* data)
+unsigned int getU1From(const byte* data)
 {
 	return (unsigned int) data[0];
 }
 
 /* get unsigned 2 bytes as little endian */
-unsigned int getU2LitFrom(byte* data)
+unsigned int getU2LitFrom(const byte* data)
 {
 	return (unsigned int) (data[0] | (data[1] << 8));
 }
 
 /* get unsigned 3 bytes as little endian */
-unsigned int getU3LitFrom(byte* data)
+unsigned int getU3LitFrom(const byte* data)
 {
 	return (unsigned int) (data[0] | (data[1] << 8) | (data[2] << 16));
 }
 
 /* get unsigned 4 bytes as little endian */
-unsigned int getU4LitFrom(byte* data)
+unsigned int getU4LitFrom(const byte* data)
 {
 	return (unsigned int) (data[0] | (data[1] << 8) | (data[2] << 16) | (data[3] << 24));
 }
 
-void readVarCom(byte* sseq, size_t* curOffset, char* outputString, byte statusByte, char* eventName, char* eventDesc){
-	if (/*sizeof(outputString) >= 23*/ true) {
-		uint8_t varNumber;
-		int16_t val;
-		const char* varMethodName[] = {
-			"=", "+=", "-=", "*=", "/=", "[Shift]", "[Rand]", "", 
-			"==", ">=", ">", "<=", "<", "!="
-		};
-		
-		varNumber = getU1From(&sseq[*curOffset]);
-		(*curOffset)++;
-		val = getU2LitFrom(&sseq[*curOffset]);
-		*curOffset += 2;
-		
-		char markerText[23]; // "Var:255,[Shift],-32767"
-		snprintf(markerText, 23, "Var:%u,%s,%d", varNumber, varMethodName[statusByte - 0xb0], val);
-		//snprintf(markerText, 23, "Var:1,1,1");
-		//printf("inner markerText: %s\n", markerText);
-		//smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 22);
-		strcpy(outputString, markerText);
-		
-		
-		sprintf(eventName, "Variable %s", varMethodName[statusByte - 0xb0]);
-		sprintf(eventDesc, "var %u : %d", varNumber, val);
-		
-		
-		//return markerText;
-		//strcpy(outputString, markerText);
-		return;
-	} else {
-		fprintf(stderr, "outputString is not large enough.\n");
-		return;
-	}
+/* format a variable command (0xB0-0xBD) */
+void formatVarCom(char* outputString, byte statusByte, int varNumber, int val)
+{
+	snprintf(outputString, 23, "Var:%u,%s,%d", (uint8_t)varNumber, sseqVarMethodName[statusByte - 0xb0], val); // "Var:255,[Shift],-32767"
 }
 
-void readUseVar(byte* sseq, size_t* curOffset, char* outputString, char* eventName, char* eventDesc){
-	// 0xA1. params: Sequence Command, u8. Replaces the last parameter of P1 with the value of variable P2
-	byte subStatusByte;
-	int varNumber;
-  
-	subStatusByte = getU1From(&sseq[*curOffset]);
-	(*curOffset)++;
-	if(subStatusByte >= 0xb0 && subStatusByte <= 0xbd) /* var */
-	{
-		/* loveemu is a lazy person :P */
-		(*curOffset)++;
-		varNumber = getU1From(&sseq[*curOffset]);
-		(*curOffset)++;
-	}
-	else
-	{
-		varNumber = getU1From(&sseq[*curOffset]);
-		(*curOffset)++;
-	}
-  
-	char markerText[16]; // "UseVar:0xFF,255"
-	snprintf(markerText, 16, "UseVar:0x%02X,%u", subStatusByte, (uint8_t)varNumber);
-	//smfInsertMetaEvent(smf, absTime+stackedEventTimeSpacer, midiCh, 6, markerText, 15);
-	strcpy(outputString, markerText);
-  
-	sprintf(eventName, "From Var (%02X)", subStatusByte);
-	sprintf(eventDesc, "var %d", varNumber);
-	
-	//strcpy(outputString, markerText);
-	return;
+/* format UseVar (0xA1): replaces the last parameter of the command with the value of variable */
+void formatUseVar(char* outputString, byte subStatusByte, int varNumber)
+{
+	snprintf(outputString, 16, "UseVar:0x%02X,%u", subStatusByte, (uint8_t)varNumber); // "UseVar:0xFF,255"
 }
 
-void readParamOfType(char* outputText, int sseqParamType, byte* sseq, size_t* curOffset, size_t* sseqOffsetBase, size_t* sseqSize){
-	char paramText[30];
-	switch (sseqParamType){
-		case BOOLPARAM:
-			int flg;
-
-			flg = getU1From(&sseq[*curOffset]);
-			(*curOffset)++;
-
-			snprintf(paramText, 30, "%s", flg ? "On" : "Off");
-			break;
-		case S8PARAM:
-			int8_t S8PARAMval;
-
-			S8PARAMval = getU1From(&sseq[*curOffset]);
-			(*curOffset)++;
-			
-			snprintf(paramText, 30, "%d", S8PARAMval);
-			break;
-		case U8PARAM:
-			uint8_t U8PARAMval;
+/* format a parameter value of the given type */
+void formatParamOfType(char* outputText, int sseqParamType, int value)
+{
+	switch(sseqParamType)
+	{
+	case BOOLPARAM:
+		sprintf(outputText, "%s", value ? "On" : "Off");
+		break;
 
-			U8PARAMval = getU1From(&sseq[*curOffset]);
-			(*curOffset)++;
-			
-			snprintf(paramText, 30, "%u", U8PARAMval);
-			break;
-		case HEXU8PARAM: 
-			uint8_t HEXU8PARAMval;
+	case S8PARAM:
+	case S16PARAM:
+	case VARLENPARAM:
+		sprintf(outputText, "%d", value);
+		break;
 
-			HEXU8PARAMval = getU1From(&sseq[*curOffset]);
-			(*curOffset)++;
-			
-			snprintf(paramText, 30, "0x%02X", HEXU8PARAMval);
-			break;
-		case S16PARAM:
-			int16_t S16PARAMval;
+	case U8PARAM:
+	case U16PARAM:
+		sprintf(outputText, "%u", value);
+		break;
 
-			S16PARAMval = getU2LitFrom(&sseq[*curOffset]);
-			*curOffset += 2;
-			
-			snprintf(paramText, 30, "%d", S16PARAMval);
-			break;
-		case U16PARAM:
-			uint16_t U16PARAMval;
+	case HEXU8PARAM:
+		sprintf(outputText, "0x%02X", value);
+		break;
 
-			U16PARAMval = getU2LitFrom(&sseq[*curOffset]);
-			*curOffset += 2;
-			
-			snprintf(paramText, 30, "%u", U16PARAMval);
-			break;
-		case HEXU24PARAM: 
-			int offsetVal;
+	case HEXU24PARAM:
+		sprintf(outputText, "0x%06X", value);
+		break;
 
-			//printf("curOffset: %d\n", *curOffset);
-			
-			offsetVal = getU3LitFrom(&sseq[*curOffset]) /*+ *sseqOffsetBase*/;
-			*curOffset += 3;
-			
-			snprintf(paramText, 30, "0x%06X", offsetVal);
-			break;
-		case VARLENPARAM:
-			int varLenVal = smfReadVarLength(&sseq[*curOffset], *sseqSize - *curOffset);
-			*curOffset += smfGetVarLengthSize(varLenVal);
-			
-			snprintf(paramText, 30, "%d", varLenVal);
-			break;
+	default:
+		strcpy(outputText, "");
+		break;
 	}
-	strcpy(outputText, paramText);
-	return;
-}
\ No newline at end of file
+}
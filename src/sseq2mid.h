@@ -49,56 +49,17 @@ typedef struct sseqComStruct {
 	uint8_t commandByte, param1, param2, param3;
 	uint8_t convToMidiEvType;
 	uint8_t CCnum; // Decides what midi CC number the sseq event will be converted to. Only read if convToMidiEvType == CC.
+	const char* logName; // event name in the conversion log
 } sseqCom;
 
-//struct sseqCom rest = {"Rest", 0x80, VARLENPARAM, NULL, NULL, REST, 0};
 // don't rely entirely on this table for conversion. Most sseq commands will have specific cases in a switch ladder to handle them. This table is to handle the many commands that just convert to a CC or Text Marker.
-sseqCom sseqComList[] = {
-	{"Rest", 0x80, VARLENPARAM, NOPARAM, NOPARAM, REST, 0},
-	{"ProgramChange", 0x81, VARLENPARAM, NOPARAM, NOPARAM, PROGRAMCHANGE, 0},
-	{"OpenTrack", 0x93, U8PARAM, HEXU24PARAM, NOPARAM, NEWTRACK, 0},
-	{"Jump", 0x94, HEXU24PARAM, NOPARAM, NOPARAM, JUMP, 0},
-	{"Call", 0x95, HEXU24PARAM, NOPARAM, NOPARAM, CALL, 0},
-	{"Random", 0xA0, HEXU8PARAM, S16PARAM, S16PARAM, TEXTMARKER, 0},
-	{"UseVar", 0xA1, HEXU8PARAM, U8PARAM, NOPARAM, TEXTMARKER, 0},
-	{"If", 0xA2, HEXU8PARAM, NOPARAM, NOPARAM, TEXTMARKER, 0},
-	{"Pan", 0xC0, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_PANPOT},
-	{"TrackVolume", 0xC1, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_VOLUME},
-	{"MasterVolume", 0xC2, U8PARAM, NOPARAM, NOPARAM, MASTERVOLSYSEX, 0},
-	{"Transpose", 0xC3, S8PARAM, NOPARAM, NOPARAM, RPNTRANSPOSE, 0},
-	{"PitchBend", 0xC4, S8PARAM, NOPARAM, NOPARAM, PITCHBEND, 0},
-	{"PitchBendRange", 0xC5, U8PARAM, NOPARAM, NOPARAM, RPNPITCHBENDRANGE, 0},
-	{"Priority", 0xC6, U8PARAM, NOPARAM, NOPARAM, CC, 14},
-	{"NoteWait", 0xC7, BOOLPARAM, NOPARAM, NOPARAM, MONOPOLY, 0},
-	{"Tie", 0xC8, BOOLPARAM, NOPARAM, NOPARAM, TEXTMARKER, 0},
-	{"PortamentoControl", 0xC9, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_PORTAMENTOCTRL},
-	{"ModDepth", 0xCA, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_MODULATION},
-	{"ModSpeed", 0xCB, U8PARAM, NOPARAM, NOPARAM, CC, 21},
-	{"ModType", 0xCC, U8PARAM, NOPARAM, NOPARAM, CC, 22},
-	{"ModRange", 0xCD, U8PARAM, NOPARAM, NOPARAM, CC, 3},
-	{"Portamento", 0xCE, BOOLPARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_PORTAMENTO},
-	{"PortamentoTime", 0xCF, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_PORTAMENTOTIME},
-	{"AttackRate", 0xD0, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_ATTACKTIME},
-	{"DecayRate", 0xD1, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_DECAYTIME},
-	{"SustainRate", 0xD2, U8PARAM, NOPARAM, NOPARAM, CC, 76},
-	{"ReleaseRate", 0xD3, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_RELEASETIME},
-	{"LoopStart", 0xD4, U8PARAM, NOPARAM, NOPARAM, LOOPSTART, 0},
-	{"Expression", 0xD5, U8PARAM, NOPARAM, NOPARAM, CC, SMF_CONTROL_EXPRESSION},
-	{"PrintVar", 0xD6, U8PARAM, NOPARAM, NOPARAM, TEXTMARKER, 0},
-	{"ModDelay", 0xE0, S16PARAM, NOPARAM, NOPARAM, TEXTMARKER, 0},
-	{"Tempo", 0xE1, U16PARAM, NOPARAM, NOPARAM, TEMPOSET, 0},
-	{"SweepPitch", 0xE3, S16PARAM, NOPARAM, NOPARAM, TEXTMARKER, 0},
-	{"LoopEnd", 0xFC, NOPARAM, NOPARAM, NOPARAM, LOOPEND, 0},
-	{"Return", 0xFD, NOPARAM, NOPARAM, NOPARAM, RETURN, 0},
-	{"SignifyMultiTrack", 0xFE, U16PARAM, NOPARAM, NOPARAM, 0, 0},
-	{"EndOfTrack", 0xFF, NOPARAM, NOPARAM, NOPARAM, 0, 0},
-};
-
-const size_t sseqComListLen=38;
+extern sseqCom sseqComList[];
+extern const size_t sseqComListLen;
 
 // new code end
 
 #define SSEQ_INVALID_OFFSET     -1
+#define SSEQ_MAX_CALL_DEPTH     3   /* calls nested deeper are ignored, as the player does */
 
 typedef struct TagSseq2midTrackState
 {
@@ -107,38 +68,178 @@ typedef struct TagSseq2midTrackState
   bool noteWait;
   size_t curOffset;
   size_t offsetToTop;
-  size_t offsetToReturn;
-  int offsetToAbsTime[ 262144 ]; // XXX
+  size_t callStack[SSEQ_MAX_CALL_DEPTH]; /* offsets to return */
+  int callDepth;
 } Sseq2midTrackState;
 
+/* loop points already put, in loop styles 1 and 2 */
+typedef struct TagSseq2midLoopPoints
+{
+  bool loopPointUsed;
+  bool loopStartPointUsed;
+  bool loopEndPointUsed;
+} Sseq2midLoopPoints;
+
+
+/* events that a subroutine put, replayed on later calls to it */
+typedef struct TagSseq2midCallBlock
+{
+  size_t offset;            /* call target */
+  int midiCh;
+  size_t firstEvent;        /* events of the first call, in the midi track */
+  size_t numEvents;
+  int startTime;
+  int duration;
+  int callDepth;            /* stack entries it takes, including nested calls */
+  bool cacheable;           /* false once it does something that can't be replayed */
+} Sseq2midCallBlock;
+
+typedef struct TagSseq2midCallCache
+{
+  Sseq2midCallBlock* block;
+  size_t numBlocks;
+  size_t maxBlocks;
+} Sseq2midCallCache;
+
+
+/* a loop body being converted, copied for the repeats of the loop */
+typedef struct TagSseq2midLoopBody
+{
+  size_t offset;            /* where the body starts */
+  int midiCh;
+  size_t firstEvent;        /* first event of the body, in the midi track */
+  int startTime;
+  int callDepth;
+  bool repeatable;          /* false once it does something that may differ on the next pass */
+} Sseq2midLoopBody;
+
+
+/* a decoded command of sseq */
+typedef struct TagSseqInstruction
+{
+  uint32_t offset;          /* offset of the command in sseq */
+  uint16_t length;          /* size of the command, including parameters */
+  byte command;             /* status byte (key for notes) */
+  byte subCommand;          /* command of If (0xA2), UseVar (0xA1) and Random (0xA0) */
+  int param[3];             /* parameters, offsets are absolute ones */
+} SseqInstruction;
+
+/* a converted event, formatted into a log line only on demand */
+typedef struct TagSseq2midEventLog
+{
+  size_t offset;            /* offset of the event in sseq */
+  const SseqInstruction* instruction; /* NULL if the event is out of sseq */
+  int value;                /* state that the instruction doesn't hold (loop count, return offset) */
+} Sseq2midEventLog;
+
 
 #define SSEQ_MAX_TRACK          16
+#define SSEQ_TIMEBASE           48  /* ticks per quarter note */
 
-typedef void (Sseq2midLogProc)(const char*);
+typedef void (Sseq2midLogProc)(const char* message, void* userData);
+
+/* how sseq data of Sseq2mid is held */
+#define SSEQ2MID_STORAGE_OWNED      0   /* malloc'd copy, freed on delete */
+#define SSEQ2MID_STORAGE_BORROWED   1   /* caller's buffer, left alone */
+#define SSEQ2MID_STORAGE_MAPPED     2   /* read-only file mapping, unmapped on delete */
 
 typedef struct TagSseq2mid
 {
-  byte* sseq;
+  const byte* sseq;
   size_t sseqSize;
+  int sseqStorage;
   Smf* smf;
   Sseq2midTrackState track[SSEQ_MAX_TRACK];
+  size_t* jumpTarget;         /* sorted offsets that a jump may land on */
+  size_t numJumpTargets;
+  byte* jumpTargetMap;        /* bitmap of jumpTarget, one bit per sseq byte */
+  int* jumpTargetAbsTime;     /* last absTime at each jump target, numJumpTargets per track */
+  SseqInstruction* instruction; /* decoded commands, sorted by offset */
+  size_t numInstructions;
   Sseq2midLogProc* logProc;
+  void* logUserData;
+  Sseq2midLogProc* warningProc;
+  void* warningUserData;
   int chOrder[SSEQ_MAX_TRACK];
   bool modifyChOrder;
   bool noReverb;
+  bool parallelTracks;
   int loopCount;
+  int loopStyle;
+  bool spacer;
 } Sseq2mid;
 
+/* a tempo change of sseq2midQueryInfo */
+typedef struct TagSseq2midTempo
+{
+  int absTime;
+  int bpm;
+} Sseq2midTempo;
+
+/* timing of a song, as sseq2midConvert would put it into midi */
+typedef struct TagSseq2midInfo
+{
+  int length;               /* ticks until the last track ends */
+  double seconds;
+  int loopStart;            /* ticks of the first endless loop, -1 if none */
+  int loopEnd;
+  double loopStartSeconds;
+  double loopEndSeconds;
+  Sseq2midTempo* tempo;     /* in order of time, freed by sseq2midFreeInfo */
+  size_t numTempos;
+  size_t maxTempos;
+} Sseq2midInfo;
+
+/* conversion of a track into smf, possibly on a thread of its own */
+typedef struct TagSseq2midTrackJob
+{
+  Sseq2mid* sseq2mid;
+  int trackIndex;
+  Smf* smf;
+  size_t sseqOffsetBase;
+  Sseq2midLoopPoints* loopPoints;
+  bool isolated;            /* must not change the state of other tracks */
+  bool needsSerial;         /* stopped as it would have */
+  bool result;
+} Sseq2midTrackJob;
+
 Sseq2mid* sseq2midCreate(const byte* sseq, size_t sseqSize, bool modifyChOrder);
+Sseq2mid* sseq2midCreateBorrowed(const byte* sseq, size_t sseqSize, bool modifyChOrder);
 Sseq2mid* sseq2midCreateFromFile(const char* filename, bool modifyChOrder);
+const byte* sseq2midLoadFile(const char* filename, size_t* dataSize, int* storage);
+void sseq2midReleaseData(const byte* data, size_t dataSize, int storage);
 void sseq2midDelete(Sseq2mid* sseq2mid);
 Sseq2mid* sseq2midCopy(Sseq2mid* sseq2mid);
 bool sseq2midConvert(Sseq2mid* sseq2mid);
+bool sseq2midQueryInfo(Sseq2mid* sseq2mid, Sseq2midInfo* info);
+void sseq2midFreeInfo(Sseq2midInfo* info);
+double sseq2midTicksToSeconds(const Sseq2midInfo* info, int ticks);
 size_t sseq2midWriteMidi(Sseq2mid* sseq2mid, byte* buffer, size_t bufferSize);
 size_t sseq2midWriteMidiFile(Sseq2mid* sseq2mid, const char* filename);
-void sseq2midSetLogProc(Sseq2mid* sseq2mid, Sseq2midLogProc* logProc);
+size_t sseq2midWriteMidiToSink(Sseq2mid* sseq2mid, SmfWriteProc* writeProc, void* userData);
+void sseq2midSetLogProc(Sseq2mid* sseq2mid, Sseq2midLogProc* logProc, void* userData);
+void sseq2midSetWarningProc(Sseq2mid* sseq2mid, Sseq2midLogProc* warningProc, void* userData);
 bool sseq2midNoReverb(Sseq2mid* sseq2mid, bool noReverb);
+bool sseq2midUseRunningStatus(Sseq2mid* sseq2mid, bool runningStatus);
+bool sseq2midParallelTracks(Sseq2mid* sseq2mid, bool parallelTracks);
 int sseq2midSetLoopCount(Sseq2mid* sseq2mid, int loopCount);
+int sseq2midSetLoopStyle(Sseq2mid* sseq2mid, int loopStyle);
+bool sseq2midUseSpacer(Sseq2mid* sseq2mid, bool spacer);
+
+/* command decoder, shared with sseqflow.c */
+typedef void (SseqDecodeProc)(const SseqInstruction* instruction, void* userData);
+
+bool sseqIsSseq(const byte* sseq, size_t sseqSize);
+bool sseqIsKnownCommand(byte commandByte);
+size_t sseqDecodeInstruction(const byte* sseq, size_t sseqSize, size_t offset, size_t sseqOffsetBase, SseqInstruction* instruction);
+bool sseqDecodeFlow(const byte* sseq, size_t sseqSize, size_t sseqOffsetBase, SseqDecodeProc* decodeProc, void* userData, SseqInstruction** instruction, size_t* numInstructions);
+bool sseqGoesOn(const SseqInstruction* instruction);
+size_t sseqGetBranch(const SseqInstruction* instruction);
+int sseqCompareInstructionOffset(const void* a, const void* b);
+
+/* little endian readers, shared with sdat.c and sseqflow.c */
+unsigned int getU2LitFrom(const byte* data);
+unsigned int getU4LitFrom(const byte* data);
 
 
 #endif /* !SSEQ2MID_H */
@@ -0,0 +1,539 @@
+/**
+ * sseqflow.c: control flow of sseq tracks, found without converting them
+ * commands are decoded along every path from the top of each track, and cut into blocks
+ * at the targets and after the commands that branch; then each track is walked depth first
+ * to find which blocks it reaches, and which edges go back to make loops
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "sseqflow.h"
+
+/* edges between blocks */
+#define SSEQ_FLOW_EDGE_NONE     0
+#define SSEQ_FLOW_EDGE_NEXT     1
+#define SSEQ_FLOW_EDGE_JUMP     2
+#define SSEQ_FLOW_EDGE_CALL     3
+#define SSEQ_FLOW_EDGE_IF       4
+
+/* state of a block in a walk */
+#define SSEQ_FLOW_UNSEEN        0
+#define SSEQ_FLOW_VISITING      1
+#define SSEQ_FLOW_VISITED       2
+
+/* a block on the path of a walk */
+typedef struct TagSseqFlowVisit
+{
+  size_t block;
+  size_t loopStart;         /* block after the last LoopStart, or SSEQ_FLOW_NO_BLOCK */
+  int loopCount;
+  int step;                 /* edges followed so far */
+} SseqFlowVisit;
+
+/* what sseqFlowDecode marks while commands are decoded */
+typedef struct TagSseqFlowDecoding
+{
+  SseqFlow* flow;
+  byte* leaderMap;
+} SseqFlowDecoding;
+
+bool sseqFlowDecode(SseqFlow* flow, byte* leaderMap);
+void sseqFlowMarkInstruction(const SseqInstruction* instruction, void* userData);
+bool sseqFlowMakeBlocks(SseqFlow* flow, const byte* leaderMap);
+bool sseqFlowWalkTrack(SseqFlow* flow, int trackIndex);
+bool sseqFlowEnterBlock(SseqFlow* flow, int trackIndex, const SseqFlowVisit* visit);
+int sseqFlowFollowEdge(const SseqFlow* flow, SseqFlowVisit* visit, SseqFlowVisit* nextVisit);
+bool sseqFlowAddLoop(SseqFlow* flow, int type, int trackIndex, size_t startOffset, size_t endOffset, int count);
+bool sseqFlowEndsBlock(const SseqInstruction* instruction);
+
+#define sseqFlowTestBit(map, offset)    ((map)[(offset) / 8] & (1 << ((offset) % 8)))
+#define sseqFlowSetBit(map, offset)     ((map)[(offset) / 8] |= (1 << ((offset) % 8)))
+
+/* analyze control flow of sseq, which is borrowed and must outlive the object.
+   returns NULL if it is not sseq */
+SseqFlow* sseqFlowCreate(const byte* sseq, size_t sseqSize)
+{
+	SseqFlow* flow;
+	byte* leaderMap;
+	bool result;
+	int trackIndex;
+	bool walkedTrack[SSEQ_MAX_TRACK] = { false };
+	bool walkedAny;
+
+	if(!sseqIsSseq(sseq, sseqSize))
+	{
+		return NULL;
+	}
+
+	flow = (SseqFlow*) calloc(1, sizeof(SseqFlow));
+	if(!flow)
+	{
+		return NULL;
+	}
+	flow->sseq = sseq;
+	flow->sseqSize = sseqSize;
+	flow->sseqOffsetBase = getU4LitFrom(&sseq[0x18]);
+	for(trackIndex = 0; trackIndex < SSEQ_MAX_TRACK; trackIndex++)
+	{
+		flow->track[trackIndex].offset = SSEQ_INVALID_OFFSET;
+		flow->track[trackIndex].openedAt = SSEQ_INVALID_OFFSET;
+	}
+	flow->track[0].opened = true;
+	flow->track[0].offset = SSEQ_FLOW_TRACK0_OFFSET;
+
+	flow->reachedMap = (byte*) calloc((sseqSize + 7) / 8, 1);
+	leaderMap = (byte*) calloc((sseqSize + 7) / 8, 1);
+	result = flow->reachedMap && leaderMap && sseqFlowDecode(flow, leaderMap) && sseqFlowMakeBlocks(flow, leaderMap);
+	free(leaderMap);
+
+	/* tracks are opened while walking others */
+	do
+	{
+		walkedAny = false;
+		for(trackIndex = 0; result && trackIndex < SSEQ_MAX_TRACK; trackIndex++)
+		{
+			if(flow->track[trackIndex].opened && !walkedTrack[trackIndex])
+			{
+				result = sseqFlowWalkTrack(flow, trackIndex);
+				walkedTrack[trackIndex] = true;
+				walkedAny = true;
+			}
+		}
+	} while(result && walkedAny);
+
+	if(!result)
+	{
+		sseqFlowDelete(flow);
+		flow = NULL;
+	}
+	return flow;
+}
+
+/* delete flow object */
+void sseqFlowDelete(SseqFlow* flow)
+{
+	if(flow)
+	{
+		free(flow->instruction);
+		free(flow->block);
+		free(flow->loop);
+		free(flow->reachedMap);
+		free(flow);
+	}
+}
+
+/* find the block that starts at offset, SSEQ_FLOW_NO_BLOCK if none */
+size_t sseqFlowFindBlock(const SseqFlow* flow, size_t offset)
+{
+	size_t low = 0;
+	size_t high = flow->numBlocks;
+
+	while(low < high)
+	{
+		size_t middle = (low + high) / 2;
+
+		if(flow->block[middle].offset < offset)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	if((low < flow->numBlocks) && (flow->block[low].offset == offset))
+	{
+		return low;
+	}
+	return SSEQ_FLOW_NO_BLOCK;
+}
+
+/* check if a byte of sseq is a part of reached command */
+bool sseqFlowIsReached(const SseqFlow* flow, size_t offset)
+{
+	return (offset < flow->sseqSize) && sseqFlowTestBit(flow->reachedMap, offset);
+}
+
+/* decode every command that some path reaches, and mark where blocks have to start */
+bool sseqFlowDecode(SseqFlow* flow, byte* leaderMap)
+{
+	SseqFlowDecoding decoding;
+
+	decoding.flow = flow;
+	decoding.leaderMap = leaderMap;
+	sseqFlowSetBit(leaderMap, SSEQ_FLOW_TRACK0_OFFSET);
+	return sseqDecodeFlow(flow->sseq, flow->sseqSize, flow->sseqOffsetBase, sseqFlowMarkInstruction, &decoding,
+		&flow->instruction, &flow->numInstructions);
+}
+
+/* mark the bytes that a decoded command covers, and the blocks that start after it and at its target */
+void sseqFlowMarkInstruction(const SseqInstruction* instruction, void* userData)
+{
+	SseqFlowDecoding* decoding = (SseqFlowDecoding*) userData;
+	size_t sseqSize = decoding->flow->sseqSize;
+	size_t endOffset = instruction->offset + instruction->length;
+	size_t branchOffset = sseqGetBranch(instruction);
+	size_t coveredOffset;
+
+	for(coveredOffset = instruction->offset; (coveredOffset < endOffset) && (coveredOffset < sseqSize); coveredOffset++)
+	{
+		sseqFlowSetBit(decoding->flow->reachedMap, coveredOffset);
+	}
+	if(sseqFlowEndsBlock(instruction) && (endOffset < sseqSize))
+	{
+		sseqFlowSetBit(decoding->leaderMap, endOffset);
+	}
+	if(branchOffset < sseqSize)
+	{
+		sseqFlowSetBit(decoding->leaderMap, branchOffset);
+	}
+}
+
+/* cut decoded commands into blocks, and link them */
+bool sseqFlowMakeBlocks(SseqFlow* flow, const byte* leaderMap)
+{
+	size_t instructionIndex;
+	size_t blockIndex;
+	size_t maxBlocks = 0;
+
+	for(instructionIndex = 0; instructionIndex < flow->numInstructions; instructionIndex++)
+	{
+		const SseqInstruction* instruction = &flow->instruction[instructionIndex];
+		SseqFlowBlock* block = flow->numBlocks ? &flow->block[flow->numBlocks - 1] : NULL;
+
+		/* a command that overlaps the previous one (jumped into its parameters) starts a block too */
+		if(!block || sseqFlowTestBit(leaderMap, instruction->offset) || (instruction->offset != block->endOffset)
+			|| sseqFlowEndsBlock(&flow->instruction[block->lastInstruction]))
+		{
+			if(flow->numBlocks == maxBlocks)
+			{
+				size_t newMaxBlocks = maxBlocks ? (maxBlocks * 2) : 64;
+				SseqFlowBlock* newBlocks = (SseqFlowBlock*) realloc(flow->block, newMaxBlocks * sizeof(SseqFlowBlock));
+
+				if(!newBlocks)
+				{
+					return false;
+				}
+				flow->block = newBlocks;
+				maxBlocks = newMaxBlocks;
+			}
+			block = &flow->block[flow->numBlocks++];
+			block->offset = instruction->offset;
+			block->firstInstruction = instructionIndex;
+			block->next = SSEQ_FLOW_NO_BLOCK;
+			block->branch = SSEQ_FLOW_NO_BLOCK;
+			block->trackMask = 0;
+		}
+		block->endOffset = instruction->offset + instruction->length;
+		block->lastInstruction = instructionIndex;
+	}
+
+	for(blockIndex = 0; blockIndex < flow->numBlocks; blockIndex++)
+	{
+		SseqFlowBlock* block = &flow->block[blockIndex];
+		const SseqInstruction* lastInstruction = &flow->instruction[block->lastInstruction];
+
+		if(sseqGoesOn(lastInstruction))
+		{
+			block->next = sseqFlowFindBlock(flow, block->endOffset);
+		}
+		block->branch = sseqFlowFindBlock(flow, sseqGetBranch(lastInstruction));
+	}
+	return true;
+}
+
+/* walk blocks that a track reaches, depth first to find the edges that go back */
+bool sseqFlowWalkTrack(SseqFlow* flow, int trackIndex)
+{
+	byte* visitState;
+	SseqFlowVisit* path;
+	size_t pathLength = 0;
+	size_t maxPathLength = 64;
+	size_t entryBlock = sseqFlowFindBlock(flow, flow->track[trackIndex].offset);
+	bool result = true;
+
+	if(entryBlock == SSEQ_FLOW_NO_BLOCK)
+	{
+		return true;
+	}
+
+	visitState = (byte*) calloc(flow->numBlocks, 1);
+	path = (SseqFlowVisit*) malloc(maxPathLength * sizeof(SseqFlowVisit));
+	if(!visitState || !path)
+	{
+		free(visitState);
+		free(path);
+		return false;
+	}
+	path[pathLength].block = entryBlock;
+	path[pathLength].loopStart = SSEQ_FLOW_NO_BLOCK;
+	path[pathLength].loopCount = 0;
+	path[pathLength].step = 0;
+	pathLength++;
+
+	while(result && pathLength > 0)
+	{
+		SseqFlowVisit* visit = &path[pathLength - 1];
+		SseqFlowVisit nextVisit;
+		int edge;
+
+		if(visit->step == 0)
+		{
+			visitState[visit->block] = SSEQ_FLOW_VISITING;
+			flow->block[visit->block].trackMask |= (1 << trackIndex);
+			if(!sseqFlowEnterBlock(flow, trackIndex, visit))
+			{
+				result = false;
+				break;
+			}
+		}
+
+		edge = sseqFlowFollowEdge(flow, visit, &nextVisit);
+		if(edge == SSEQ_FLOW_EDGE_NONE)
+		{
+			visitState[visit->block] = SSEQ_FLOW_VISITED;
+			pathLength--;
+		}
+		else if(nextVisit.block == SSEQ_FLOW_NO_BLOCK)
+		{
+			/* runs out of sseq */
+			flow->track[trackIndex].reachesEnd = true;
+		}
+		else if(visitState[nextVisit.block] == SSEQ_FLOW_VISITING)
+		{
+			int loopType = SSEQ_FLOW_LOOP_JUMP;
+
+			if(edge == SSEQ_FLOW_EDGE_IF)
+			{
+				loopType = SSEQ_FLOW_LOOP_IF;
+			}
+			else if(edge == SSEQ_FLOW_EDGE_CALL)
+			{
+				loopType = SSEQ_FLOW_LOOP_CALL;
+			}
+			else
+			{
+				flow->track[trackIndex].endless = true;
+			}
+			result = sseqFlowAddLoop(flow, loopType, trackIndex, flow->block[nextVisit.block].offset,
+				flow->instruction[flow->block[visit->block].lastInstruction].offset, 0);
+		}
+		else if(visitState[nextVisit.block] == SSEQ_FLOW_UNSEEN)
+		{
+			if(pathLength == maxPathLength)
+			{
+				SseqFlowVisit* newPath = (SseqFlowVisit*) realloc(path, maxPathLength * 2 * sizeof(SseqFlowVisit));
+
+				if(!newPath)
+				{
+					result = false;
+					break;
+				}
+				path = newPath;
+				maxPathLength *= 2;
+			}
+			path[pathLength++] = nextVisit;
+		}
+	}
+
+	free(path);
+	free(visitState);
+	return result;
+}
+
+/* take what a block tells on the first visit: tracks it opens, loops it closes, and ends */
+bool sseqFlowEnterBlock(SseqFlow* flow, int trackIndex, const SseqFlowVisit* visit)
+{
+	SseqFlowBlock* block = &flow->block[visit->block];
+	const SseqInstruction* lastInstruction = &flow->instruction[block->lastInstruction];
+	SseqFlowTrack* track = &flow->track[trackIndex];
+	size_t instructionIndex;
+
+	if((trackIndex == 0) && (flow->allocatedTracks == 0))
+	{
+		for(instructionIndex = block->firstInstruction; instructionIndex <= block->lastInstruction; instructionIndex++)
+		{
+			if(flow->instruction[instructionIndex].command == 0xfe)
+			{
+				flow->allocatedTracks = (unsigned int) flow->instruction[instructionIndex].param[0];
+				break;
+			}
+		}
+	}
+
+	switch(lastInstruction->command)
+	{
+	case 0x93:
+	{
+		int openIndex = lastInstruction->param[0];
+
+		/* the first one opens the track, out of range ones are left for the report */
+		if((openIndex < SSEQ_MAX_TRACK) && !flow->track[openIndex].opened && (block->branch != SSEQ_FLOW_NO_BLOCK))
+		{
+			flow->track[openIndex].opened = true;
+			flow->track[openIndex].offset = (size_t) lastInstruction->param[1];
+			flow->track[openIndex].openedAt = lastInstruction->offset;
+		}
+		break;
+	}
+
+	case 0xfc:
+		if(visit->loopStart != SSEQ_FLOW_NO_BLOCK)
+		{
+			if(block->branch == SSEQ_FLOW_NO_BLOCK)
+			{
+				block->branch = visit->loopStart;
+			}
+			if(visit->loopCount == 0)
+			{
+				track->endless = true;
+			}
+			return sseqFlowAddLoop(flow, (visit->loopCount == 0) ? SSEQ_FLOW_LOOP_ENDLESS : SSEQ_FLOW_LOOP_COUNTED,
+				trackIndex, flow->block[visit->loopStart].offset, lastInstruction->offset, visit->loopCount);
+		}
+		break;
+
+	case 0xfd:
+		break;
+
+	case 0xff:
+		track->reachesEnd = true;
+		break;
+
+	default:
+		/* unknown command stops the track */
+		if(!sseqIsKnownCommand(lastInstruction->command))
+		{
+			track->reachesEnd = true;
+		}
+		break;
+	}
+	return true;
+}
+
+/* give the next edge of a block into nextVisit, SSEQ_FLOW_EDGE_NONE if no more */
+int sseqFlowFollowEdge(const SseqFlow* flow, SseqFlowVisit* visit, SseqFlowVisit* nextVisit)
+{
+	const SseqFlowBlock* block = &flow->block[visit->block];
+	const SseqInstruction* lastInstruction = &flow->instruction[block->lastInstruction];
+	int step = visit->step++;
+	int edge = SSEQ_FLOW_EDGE_NONE;
+
+	*nextVisit = *visit;
+	nextVisit->step = 0;
+	nextVisit->block = block->next;
+
+	switch(lastInstruction->command)
+	{
+	case 0x94:
+		if(step == 0)
+		{
+			nextVisit->block = block->branch;
+			edge = SSEQ_FLOW_EDGE_JUMP;
+		}
+		break;
+
+	case 0x95:
+		/* the subroutine, and then where it returns to */
+		if(step == 0)
+		{
+			nextVisit->block = block->branch;
+			edge = SSEQ_FLOW_EDGE_CALL;
+		}
+		else if(step == 1)
+		{
+			edge = SSEQ_FLOW_EDGE_NEXT;
+		}
+		break;
+
+	case 0xa2:
+		if((lastInstruction->subCommand == 0x94) && (step == 0))
+		{
+			nextVisit->block = block->branch;
+			edge = SSEQ_FLOW_EDGE_IF;
+		}
+		else if(step == ((lastInstruction->subCommand == 0x94) ? 1 : 0))
+		{
+			edge = SSEQ_FLOW_EDGE_NEXT;
+		}
+		break;
+
+	case 0xd4:
+		if(step == 0)
+		{
+			nextVisit->loopStart = block->next;
+			nextVisit->loopCount = lastInstruction->param[0];
+			edge = SSEQ_FLOW_EDGE_NEXT;
+		}
+		break;
+
+	case 0xfc:
+		/* an endless loop never gets out, a counted one does and is over */
+		if((step == 0) && ((visit->loopStart == SSEQ_FLOW_NO_BLOCK) || (visit->loopCount > 0)))
+		{
+			nextVisit->loopStart = SSEQ_FLOW_NO_BLOCK;
+			edge = SSEQ_FLOW_EDGE_NEXT;
+		}
+		break;
+
+	case 0xfd:
+	case 0xff:
+		break;
+
+	default:
+		if((step == 0) && sseqIsKnownCommand(lastInstruction->command))
+		{
+			edge = SSEQ_FLOW_EDGE_NEXT;
+		}
+		break;
+	}
+	return edge;
+}
+
+/* add a loop found on a track */
+bool sseqFlowAddLoop(SseqFlow* flow, int type, int trackIndex, size_t startOffset, size_t endOffset, int count)
+{
+	SseqFlowLoop* loop;
+
+	if(flow->numLoops == flow->maxLoops)
+	{
+		size_t newMaxLoops = flow->maxLoops ? (flow->maxLoops * 2) : 16;
+		SseqFlowLoop* newLoops = (SseqFlowLoop*) realloc(flow->loop, newMaxLoops * sizeof(SseqFlowLoop));
+
+		if(!newLoops)
+		{
+			return false;
+		}
+		flow->loop = newLoops;
+		flow->maxLoops = newMaxLoops;
+	}
+	loop = &flow->loop[flow->numLoops++];
+	loop->type = type;
+	loop->track = trackIndex;
+	loop->startOffset = startOffset;
+	loop->endOffset = endOffset;
+	loop->count = count;
+	return true;
+}
+
+/* check if a command is the last one of its block */
+bool sseqFlowEndsBlock(const SseqInstruction* instruction)
+{
+	switch(instruction->command)
+	{
+	case 0x93:
+	case 0x94:
+	case 0x95:
+	case 0xd4:
+	case 0xfc:
+	case 0xfd:
+	case 0xff:
+		return true;
+
+	case 0xa2:
+		return (instruction->subCommand == 0x94);
+
+	default:
+		return !sseqIsKnownCommand(instruction->command);
+	}
+}
@@ -0,0 +1,76 @@
+/**
+ * sseqflow.h: control flow of sseq tracks, found without converting them
+ */
+
+#ifndef SSEQFLOW_H
+#define SSEQFLOW_H
+
+
+#include <stddef.h>
+#include "libsmfc.h"
+#include "sseq2mid.h"
+
+#define SSEQ_FLOW_NO_BLOCK      ((size_t) -1)
+#define SSEQ_FLOW_TRACK0_OFFSET 0x1c    /* DATA starts with track 0 */
+
+/* commands entered only at the top, and left only at the bottom */
+typedef struct TagSseqFlowBlock
+{
+  size_t offset;            /* first command */
+  size_t endOffset;         /* right after the last command */
+  size_t firstInstruction;  /* index in instruction of SseqFlow */
+  size_t lastInstruction;   /* command that may leave the block */
+  size_t next;              /* block to go on with (after return, for Call), or SSEQ_FLOW_NO_BLOCK */
+  size_t branch;            /* target of OpenTrack, Jump, Call and If'd Jump, or start of loop for LoopEnd */
+  unsigned int trackMask;   /* tracks that reach the block */
+} SseqFlowBlock;
+
+/* shapes of loop */
+#define SSEQ_FLOW_LOOP_JUMP     0   /* goes back by Jump, endless */
+#define SSEQ_FLOW_LOOP_IF       1   /* goes back by If'd Jump, while the condition holds */
+#define SSEQ_FLOW_LOOP_COUNTED  2   /* LoopStart n ... LoopEnd */
+#define SSEQ_FLOW_LOOP_ENDLESS  3   /* LoopStart 0 ... LoopEnd */
+#define SSEQ_FLOW_LOOP_CALL     4   /* a subroutine calls itself, up to the call depth */
+
+typedef struct TagSseqFlowLoop
+{
+  int type;
+  int track;
+  size_t startOffset;       /* first command of the body */
+  size_t endOffset;         /* command that goes back */
+  int count;                /* of LoopStart */
+} SseqFlowLoop;
+
+typedef struct TagSseqFlowTrack
+{
+  bool opened;
+  size_t offset;
+  size_t openedAt;          /* OpenTrack command, SSEQ_INVALID_OFFSET for track 0 */
+  bool reachesEnd;          /* some path stops (End of Track, unknown command) */
+  bool endless;             /* some path loops forever */
+} SseqFlowTrack;
+
+typedef struct TagSseqFlow
+{
+  const byte* sseq;         /* borrowed, must outlive the object */
+  size_t sseqSize;
+  size_t sseqOffsetBase;
+  unsigned int allocatedTracks; /* of SignifyMultiTrack on track 0, 0 if none */
+  SseqFlowTrack track[SSEQ_MAX_TRACK];
+  SseqInstruction* instruction; /* reached commands, sorted by offset */
+  size_t numInstructions;
+  SseqFlowBlock* block;     /* sorted by offset */
+  size_t numBlocks;
+  SseqFlowLoop* loop;
+  size_t numLoops;
+  size_t maxLoops;
+  byte* reachedMap;         /* bitmap of bytes covered by reached commands */
+} SseqFlow;
+
+SseqFlow* sseqFlowCreate(const byte* sseq, size_t sseqSize);
+void sseqFlowDelete(SseqFlow* flow);
+size_t sseqFlowFindBlock(const SseqFlow* flow, size_t offset);
+bool sseqFlowIsReached(const SseqFlow* flow, size_t offset);
+
+
+#endif /* !SSEQFLOW_H */